@@ -1,5 +1,6 @@
 #include "RoomPrompt.h"
 #include "Utils.h"
+#include "client/JsonWriter.h"
 #include <windows.h>
 #include <chrono>
 #include <thread>
@@ -42,10 +43,12 @@ namespace App {
         if (choice == IDYES) {
             std::string randomRoomAlias =
                 "room_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
-            std::string createBody =
-                "{\"room_alias_name\":\"" + randomRoomAlias + "\", "
-                "\"visibility\":\"public\", "
-                "\"preset\":\"private_chat\"}";
+            std::string createBody;
+            JsonWriter(createBody).BeginObject()
+                .Field("room_alias_name", randomRoomAlias)
+                .Field("visibility", "public")
+                .Field("preset", "private_chat")
+                .EndObject();
 
             auto resp = matrix.HttpRequest(L"POST", L"/_matrix/client/r0/createRoom", createBody, true);
             std::string roomId = matrix.ExtractJsonValue(resp, "room_id");
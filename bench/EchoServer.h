@@ -0,0 +1,193 @@
+#pragma once
+#include "WebSocketClient.h"
+#include "WebSocketDeflate.h"
+#include "WebSocketFrameParser.h"
+#include "SocketCompat.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// In-process loopback WebSocket server for the benchmarks and tests: accepts any handshake,
+// echoes data frames, answers pings, one thread per connection. Optionally accepts
+// permessage-deflate (default parameters) and cuts every connection after a number of data
+// messages, to exercise reconnects.
+class EchoServer {
+public:
+    // Must be called before Start(). Sees every data message received, on its connection's thread.
+    void SetOnMessage(std::function<void(std::string_view payload)> cb) { m_onMessage = std::move(cb); }
+    // Must be called before Start(). Each connection is shut down after `messages` data messages
+    // (0 keeps them open); what the client wrote after that is never read.
+    void SetDropAfter(size_t messages) { m_dropAfter = messages; }
+    // Must be called before Start(). Accept permessage-deflate when offered; compressed messages
+    // are echoed compressed.
+    void SetDeflate(bool accept) { m_deflate = accept; }
+
+    bool Start() {
+        Net::Startup();
+        m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listen == INVALID_SOCKET) return false;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(m_listen, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listen, SOMAXCONN) != 0 ||
+            getsockname(m_listen, (sockaddr*)&addr, &len) != 0) return false;
+        m_port = ntohs(addr.sin_port);
+
+        m_acceptThread = std::thread([this] {
+            for (;;) {
+                SOCKET s = accept(m_listen, nullptr, nullptr);
+                if (s == INVALID_SOCKET) return;
+                m_connections++;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_sockets.push_back(s);
+                m_workers.emplace_back(&EchoServer::Serve, this, s);
+            }
+        });
+        return true;
+    }
+
+    void Stop() {
+        shutdown(m_listen, SD_BOTH);
+        closesocket(m_listen);
+        if (m_acceptThread.joinable()) m_acceptThread.join();
+        for (SOCKET s : m_sockets) shutdown(s, SD_BOTH);
+        for (auto& t : m_workers) t.join();
+        for (SOCKET s : m_sockets) closesocket(s);
+    }
+
+    uint16_t Port() const { return m_port; }
+    size_t Connections() const { return m_connections.load(); } // accepted so far
+    uint64_t BytesReceived() const { return m_bytesReceived.load(); } // on the wire, after the handshakes
+
+private:
+    static void AppendFrame(std::vector<uint8_t>& out, WsOpcode opcode, std::string_view payload, bool compressed = false) {
+        out.push_back(0x80 | (compressed ? 0x40 : 0) | static_cast<uint8_t>(opcode));
+        const size_t n = payload.size();
+        if (n <= 125) {
+            out.push_back(static_cast<uint8_t>(n));
+        } else if (n <= 65535) {
+            out.push_back(126);
+            out.push_back(static_cast<uint8_t>(n >> 8));
+            out.push_back(static_cast<uint8_t>(n));
+        } else {
+            out.push_back(127);
+            for (int i = 7; i >= 0; --i) out.push_back(static_cast<uint8_t>((uint64_t)n >> (8 * i)));
+        }
+        out.insert(out.end(), payload.begin(), payload.end());
+    }
+
+    static bool SendAll(SOCKET s, std::vector<uint8_t>& out) {
+        size_t sent = 0;
+        while (sent < out.size()) {
+            IoBuf buf;
+            Net::SetIoBuf(buf, out.data() + sent, out.size() - sent);
+            long long n = Net::SendV(s, &buf, 1);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        out.clear();
+        return true;
+    }
+
+    void Serve(SOCKET s) {
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+
+        std::string request;
+        char chunk[4096];
+        size_t end;
+        while ((end = request.find("\r\n\r\n")) == std::string::npos) {
+            int n = recv(s, chunk, sizeof(chunk), 0);
+            if (n <= 0) return;
+            request.append(chunk, n);
+        }
+        size_t keyPos = request.find("Sec-WebSocket-Key: ");
+        if (keyPos == std::string::npos) return;
+        keyPos += 19;
+        std::string key = request.substr(keyPos, request.find("\r\n", keyPos) - keyPos);
+
+        // Both directions with a 15-bit window and context takeover, whatever the client offered
+        std::unique_ptr<WebSocketDeflate> deflate;
+        std::string extensions;
+        if (m_deflate && request.substr(0, end).find("permessage-deflate") != std::string::npos) {
+            deflate = std::make_unique<WebSocketDeflate>(DeflateParams{});
+            if (deflate->Ok()) extensions = "Sec-WebSocket-Extensions: permessage-deflate\r\n";
+            else deflate.reset();
+        }
+
+        std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n" +
+                               extensions + "Sec-WebSocket-Accept: " + ComputeAcceptKey(key) + "\r\n\r\n";
+        std::vector<uint8_t> out(response.begin(), response.end());
+        if (!SendAll(s, out)) return;
+
+        WebSocketFrameParser parser;
+        parser.SetAllowRsv1(deflate != nullptr);
+        std::vector<uint8_t> inflated, deflated;
+        for (std::string_view rest = std::string_view(request).substr(end + 4); !rest.empty();) {
+            auto space = parser.WritableSpan();
+            size_t n = std::min(space.size(), rest.size());
+            std::memcpy(space.data(), rest.data(), n);
+            parser.Commit(n);
+            rest.remove_prefix(n);
+        }
+
+        size_t messages = 0;
+        for (;;) {
+            WsMessage msg;
+            WebSocketFrameParser::Result r;
+            while ((r = parser.Next(msg)) == WebSocketFrameParser::Result::Message) {
+                switch (msg.opcode) {
+                    case WsOpcode::Ping:  AppendFrame(out, WsOpcode::Pong, msg.payload); break;
+                    case WsOpcode::Close: AppendFrame(out, WsOpcode::Close, {}); SendAll(s, out); return;
+                    case WsOpcode::Pong:  break;
+                    default:
+                        if (msg.compressed) {
+                            auto* in = reinterpret_cast<const uint8_t*>(msg.payload.data());
+                            if (!deflate->Decompress({ in, msg.payload.size() }, inflated, 64 * 1024 * 1024) ||
+                                !deflate->Compress(inflated, deflated)) return;
+                            if (m_onMessage) m_onMessage({ reinterpret_cast<const char*>(inflated.data()), inflated.size() });
+                            AppendFrame(out, msg.opcode, { reinterpret_cast<const char*>(deflated.data()), deflated.size() }, true);
+                        } else {
+                            if (m_onMessage) m_onMessage(msg.payload);
+                            AppendFrame(out, msg.opcode, msg.payload);
+                        }
+                        if (++messages == m_dropAfter) {
+                            SendAll(s, out);
+                            shutdown(s, SD_BOTH); // no close frame: the link just dies
+                            return;
+                        }
+                        break;
+                }
+            }
+            if (r == WebSocketFrameParser::Result::Error || !SendAll(s, out)) return;
+
+            auto space = parser.WritableSpan();
+            int n = recv(s, reinterpret_cast<char*>(space.data()), (int)space.size(), 0);
+            if (n <= 0) return;
+            m_bytesReceived += static_cast<uint64_t>(n);
+            parser.Commit(n);
+        }
+    }
+
+    std::function<void(std::string_view)> m_onMessage;
+    size_t m_dropAfter = 0;
+    bool m_deflate = false;
+
+    SOCKET m_listen = INVALID_SOCKET;
+    uint16_t m_port = 0;
+    std::atomic<size_t> m_connections{ 0 };
+    std::atomic<uint64_t> m_bytesReceived{ 0 };
+    std::thread m_acceptThread;
+    std::mutex m_mutex;
+    std::vector<SOCKET> m_sockets;
+    std::vector<std::thread> m_workers;
+};
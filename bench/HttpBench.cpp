@@ -0,0 +1,841 @@
+// Client-server API benchmarks against the in-process mock homeserver. MatrixClient itself is
+// Win32-only, so its request flows are replayed through the same portable pieces it uses
+// (SocketHttpTransport standing in for WinHttpTransport). Prints one JSON document for the
+// benchmark chosen with --bench:
+//
+//   keepalive  sequential sync-shaped requests with a new connection per request (as before the
+//              pool) and with keep-alive: latency percentiles, requests/sec and handshakes
+//   arrival    a long-polling sync loop with the old pacing (timeout=3000, 100 ms sleep after every
+//              sync) and with SyncScheduler, while messages are posted one at a time 0.1-1 s apart
+//              or in bursts of five 30 ms apart every 1.5 s: delay from posting a message to
+//              parsing it, and polls per minute while busy and then while idle (idle runs need
+//              --duration-ms of a minute or more to show the 30 s long polls)
+//   receipts   read receipts for sync batches of --messages messages spread over three rooms: one
+//              blocking POST per message on the sync thread (as before) against ReceiptCoalescer:
+//              time the sync thread is held per batch and requests sent per batch
+//   fanout     --sends fire-and-forget message sends in bursts of 20 per millisecond, each started
+//              with std::async and its future kept until shutdown (the old LaunchTask) and through
+//              MatrixClient's WorkerPool{2, 256}: submit cost, time until all are done, heap still
+//              held before shutdown, threads started, peak queue depth and rejected sends
+//   pipeline   --sends messages to one room, typed in bursts of ten per millisecond, each on its own
+//              std::async thread with a millisecond-tick transaction ID (as before) and through
+//              SendPipeline for every --windows size: messages/sec, and what the server stored:
+//              messages lost to reused transaction IDs and messages out of order
+//   coldstart  time to the first message at launch with stored credentials: the old serial path
+//              (whoami, then rejoining the last room, then a full initial sync of --rooms rooms on
+//              the sync connection) against ResumeSession (whoami, rejoin and an incremental sync
+//              from the stored token at once, the timeline store opened meanwhile), also without a
+//              stored token or history as on the first launch after the update: time until stored
+//              history and until the first new message are on screen, requests and connections
+//
+// Every connection first costs --handshake-rtts round-trips (TCP + TLS) of --rtt-ms each, and
+// every response one round-trip. coldstart adds server time per request: 600 ms for an initial
+// sync, 15 ms for an incremental one, 40 ms for a join and 5 ms for whoami.
+//
+//   HttpBench [--bench keepalive|arrival|receipts|fanout|pipeline|coldstart] [--duration-ms 2000]
+//             [--rtt-ms 0,20] [--handshake-rtts 2] [--messages 50] [--sends 10000] [--windows 1,4,8,16]
+//             [--rooms 20] [--runs 5] [--out results.json]
+//
+// arrival runs 5000 ms by default. fanout defaults to --rtt-ms 0, where a round-trip would only
+// show the pool's queue filling; pipeline to --rtt-ms 20 and --sends 200; coldstart to --rtt-ms 50.
+#include "MockHomeserver.h"
+#include "ReceiptCoalescer.h"
+#include "SendPipeline.h"
+#include "JsonIndex.h"
+#include "RoomTimelines.h"
+#include "SocketHttpTransport.h"
+#include "SyncParser.h"
+#include "SyncScheduler.h"
+#include "TimelineStore.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <new>
+#include <mutex>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// ----------------- Heap accounting -----------------
+// Every allocation carries its size in front, so the bytes live at any moment are known
+static std::atomic<long long> g_liveBytes{ 0 };
+
+static void* Allocate(size_t size) {
+    g_liveBytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    auto* p = static_cast<size_t*>(std::malloc(size + 16));
+    if (!p) throw std::bad_alloc();
+    *p = size;
+    return p + 2;
+}
+
+static void Release(void* p) {
+    if (!p) return;
+    auto* header = static_cast<size_t*>(p) - 2;
+    g_liveBytes.fetch_sub(static_cast<long long>(*header), std::memory_order_relaxed);
+    std::free(header);
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void operator delete(void* p) noexcept { Release(p); }
+void operator delete[](void* p) noexcept { Release(p); }
+void operator delete(void* p, size_t) noexcept { Release(p); }
+void operator delete[](void* p, size_t) noexcept { Release(p); }
+
+struct Network {
+    std::chrono::milliseconds rtt;
+    int handshakeRoundTrips;
+};
+
+static bool StartServer(MockHomeserver& server, const Network& net, MockHomeserver::Handler handler) {
+    server.SetRoundTrip(net.rtt);
+    server.SetHandshakeRoundTrips(net.handshakeRoundTrips);
+    server.SetHandler(std::move(handler));
+    if (server.Start()) return true;
+    std::fprintf(stderr, "cannot start mock homeserver\n");
+    return false;
+}
+
+static double Percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// ----------------- Keep-alive -----------------
+struct KeepAliveResult {
+    uint64_t requests = 0;
+    uint64_t connections = 0;
+    double seconds = 0;
+    std::vector<double> latencyMs;
+};
+
+static KeepAliveResult RunKeepAliveCase(uint16_t port, bool keepAlive, std::chrono::milliseconds duration) {
+    SocketHttpTransport http("127.0.0.1", port);
+    http.SetKeepAlive(keepAlive);
+    KeepAliveResult result;
+    std::string since = "s0";
+    auto start = Clock::now();
+    while (Clock::now() - start < duration) {
+        auto sent = Clock::now();
+        HttpResponse r = http.Request("GET", "/_matrix/client/r0/sync?timeout=0&since=" + since, "", "tok");
+        result.latencyMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent).count());
+        if (r.status != 200) {
+            std::fprintf(stderr, "request failed with status %d\n", r.status);
+            std::exit(1);
+        }
+        since = "s" + std::to_string(result.latencyMs.size());
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    HttpTransportStats stats = http.GetStats();
+    result.requests = stats.requests;
+    result.connections = stats.connectionsOpened;
+    return result;
+}
+
+static void RunKeepAlive(std::FILE* out, const std::vector<long>& rtts, int handshakeRoundTrips, std::chrono::milliseconds duration) {
+    // An incremental sync with nothing new, padded to a typical size
+    const std::string body = "{\"next_batch\":\"s1\",\"rooms\":{\"join\":{}},\"presence\":{\"events\":[]},\"pad\":\"" +
+                             std::string(2000, 'x') + "\"}";
+    std::fprintf(out, "{\n  \"benchmark\": \"http_keepalive\",\n  \"duration_ms\": %lld,\n  \"handshake_rtts\": %d,\n  \"results\": [",
+                 (long long)duration.count(), handshakeRoundTrips);
+    bool first = true;
+    for (long rtt : rtts) {
+        MockHomeserver server;
+        if (!StartServer(server, { std::chrono::milliseconds(rtt), handshakeRoundTrips },
+                         [&body](const MockRequest&) { return MockResponse{ 200, body }; })) std::exit(1);
+        for (bool keepAlive : { false, true }) {
+            KeepAliveResult r = RunKeepAliveCase(server.Port(), keepAlive, duration);
+            std::fprintf(out,
+                "%s\n    {\"rtt_ms\": %ld, \"keep_alive\": %s, \"requests\": %llu, \"requests_per_sec\": %.0f, "
+                "\"latency_ms\": {\"p50\": %.3f, \"p99\": %.3f}, \"connections\": %llu, \"handshakes_per_minute\": %.0f}",
+                first ? "" : ",", rtt, keepAlive ? "true" : "false", (unsigned long long)r.requests, r.requests / r.seconds,
+                Percentile(r.latencyMs, 0.50), Percentile(r.latencyMs, 0.99), (unsigned long long)r.connections,
+                r.connections * 60 / r.seconds);
+            std::fflush(out);
+            first = false;
+        }
+        server.Stop();
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Message arrival -----------------
+// Messages posted by other users; a /sync since=sN returns those from N on, holding the poll up to
+// its timeout= while there are none
+class MessageFeed {
+public:
+    void Post() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_postedAt.push_back(Clock::now());
+        m_cv.notify_all();
+    }
+
+    void Release() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_released = true;
+        m_cv.notify_all();
+    }
+
+    Clock::time_point PostedAt(size_t index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_postedAt[index];
+    }
+
+    MockResponse Sync(const MockRequest& request) {
+        m_polls++;
+        std::string since = request.Query("since");
+        long timeoutMs = std::strtol(request.Query("timeout").c_str(), nullptr, 10);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // An initial sync starts from now: nothing posted before counts
+        size_t from = since.empty() ? m_postedAt.size() : std::strtoull(since.c_str() + 1, nullptr, 10);
+        m_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return m_released || m_postedAt.size() > from; });
+        std::string body = "{\"next_batch\":\"s" + std::to_string(m_postedAt.size()) + "\",\"rooms\":{\"join\":{\"!room:x\":{\"timeline\":{\"events\":[";
+        for (size_t i = from; i < m_postedAt.size(); ++i) {
+            body += std::string(i > from ? "," : "") + "{\"type\":\"m.room.message\",\"sender\":\"@peer:x\",\"event_id\":\"$" +
+                    std::to_string(i) + "\",\"content\":{\"msgtype\":\"m.text\",\"body\":\"hello\"}}";
+        }
+        return { 200, body + "]}}}}}" };
+    }
+
+    uint64_t Polls() const { return m_polls.load(); }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Clock::time_point> m_postedAt;
+    bool m_released = false;
+    std::atomic<uint64_t> m_polls{ 0 };
+};
+
+struct ArrivalResult {
+    std::vector<double> latencyMs;
+    size_t posted = 0;
+    double busyPollsPerMinute = 0;
+    double idlePollsPerMinute = 0;
+};
+
+// SyncLoop() and SyncOnce() of MatrixClient, paced the old way or by SyncScheduler
+static ArrivalResult RunArrivalCase(uint16_t port, MessageFeed& feed, bool scheduler, bool bursts,
+                                    std::chrono::milliseconds duration) {
+    SocketHttpTransport http("127.0.0.1", port);
+    http.SetTimeout(std::chrono::seconds(45));
+    SyncScheduler pacing;
+    std::atomic<bool> running{ true };
+    std::mutex mutex;
+    std::vector<double> latencyMs;
+    std::thread syncThread([&] {
+        std::string nextBatch;
+        while (running && (!scheduler || pacing.WaitForTurn())) {
+            long timeoutMs = scheduler ? (long)pacing.NextTimeout(nextBatch.empty()).count() : 3000;
+            std::string target = "/_matrix/client/r0/sync?timeout=" + std::to_string(timeoutMs);
+            if (!nextBatch.empty()) target += "&since=" + nextBatch;
+            HttpResponse r = http.Request("GET", target, "", "tok");
+            SyncBatch batch;
+            bool ok = r.status == 200 && ParseSync(r.body, [](std::string_view) { return true; }, batch) && !batch.nextBatch.empty();
+            if (ok) {
+                nextBatch = batch.nextBatch;
+                auto now = Clock::now();
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const auto& ev : batch.events) {
+                    auto posted = feed.PostedAt(std::strtoull(ev.eventId.c_str() + 1, nullptr, 10));
+                    latencyMs.push_back(std::chrono::duration<double, std::milli>(now - posted).count());
+                }
+            }
+            if (!scheduler) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            else if (ok) pacing.OnSuccess();
+            else pacing.OnFailure();
+        }
+    });
+
+    ArrivalResult result;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // the initial sync
+    std::mt19937 rng(42);
+    uint64_t polls = feed.Polls();
+    auto start = Clock::now();
+    while (Clock::now() - start < duration) {
+        for (int i = 0; i < (bursts ? 5 : 1); ++i) {
+            if (i) std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            feed.Post();
+            result.posted++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(bursts ? 1500 : 100 + rng() % 900));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300)); // the last one comes in
+    auto busy = Clock::now() - start;
+    result.busyPollsPerMinute = (feed.Polls() - polls) * 60 / std::chrono::duration<double>(busy).count();
+
+    polls = feed.Polls();
+    start = Clock::now();
+    std::this_thread::sleep_for(duration);
+    result.idlePollsPerMinute = (feed.Polls() - polls) * 60 / std::chrono::duration<double>(Clock::now() - start).count();
+
+    running = false;
+    pacing.Stop();
+    http.CancelAll();
+    syncThread.join();
+    result.latencyMs = std::move(latencyMs);
+    return result;
+}
+
+static void RunArrival(std::FILE* out, const std::vector<long>& rtts, int handshakeRoundTrips, std::chrono::milliseconds duration) {
+    std::fprintf(out, "{\n  \"benchmark\": \"sync_arrival\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+                 (long long)duration.count());
+    bool first = true;
+    for (long rtt : rtts) {
+        for (int c = 0; c < 4; ++c) {
+            const bool bursts = c >= 2, scheduler = c % 2 == 1;
+            MessageFeed feed;
+            MockHomeserver server;
+            if (!StartServer(server, { std::chrono::milliseconds(rtt), handshakeRoundTrips },
+                             [&feed](const MockRequest& request) { return feed.Sync(request); })) std::exit(1);
+            ArrivalResult r = RunArrivalCase(server.Port(), feed, scheduler, bursts, duration);
+            feed.Release();
+            server.Stop();
+
+            double mean = 0;
+            for (double v : r.latencyMs) mean += v;
+            mean /= std::max<size_t>(r.latencyMs.size(), 1);
+            std::fprintf(out,
+                "%s\n    {\"rtt_ms\": %ld, \"traffic\": \"%s\", \"pacing\": \"%s\", \"posted\": %zu, \"received\": %zu, "
+                "\"arrival_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f}, "
+                "\"busy_polls_per_minute\": %.0f, \"idle_polls_per_minute\": %.1f}",
+                first ? "" : ",", rtt, bursts ? "bursts" : "random", scheduler ? "scheduler" : "fixed", r.posted,
+                r.latencyMs.size(), mean, Percentile(r.latencyMs, 0.50), Percentile(r.latencyMs, 0.99),
+                r.busyPollsPerMinute, r.idlePollsPerMinute);
+            std::fflush(out);
+            first = false;
+        }
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Read receipts -----------------
+struct ReceiptResult {
+    double blockedMs = 0;        // per batch
+    double requestsPerBatch = 0;
+    size_t batches = 0;
+};
+
+static ReceiptResult RunReceiptCase(MockHomeserver& server, bool coalesce, int messages, std::chrono::milliseconds duration) {
+    static const char* const kRooms[] = { "!a:matrix.org", "!b:matrix.org", "!c:matrix.org" };
+    SocketHttpTransport http("127.0.0.1", server.Port());
+    auto postReceipt = [&http](const std::string& roomId, const std::string& eventId) {
+        return http.Request("POST", "/_matrix/client/r0/rooms/" + roomId + "/receipt/m.read/" + eventId, "{}", "tok").status == 200;
+    };
+    ReceiptCoalescer receipts([&http](const std::string& roomId, const std::string& eventId) {
+        std::string body = "{\"m.fully_read\":\"" + eventId + "\",\"m.read\":\"" + eventId + "\"}";
+        return http.Request("POST", "/_matrix/client/r0/rooms/" + roomId + "/read_markers", body, "tok").status == 200;
+    }, std::chrono::milliseconds(200));
+    receipts.Start();
+
+    ReceiptResult result;
+    uint64_t requests = server.Requests();
+    double blockedMs = 0;
+    int event = 0;
+    auto start = Clock::now();
+    while (Clock::now() - start < duration || result.batches < 3) {
+        auto t0 = Clock::now();
+        for (int i = 0; i < messages; ++i, ++event) {
+            std::string eventId = "$" + std::to_string(event);
+            if (coalesce) receipts.Mark(kRooms[i % 3], eventId);
+            else postReceipt(kRooms[i % 3], eventId);
+        }
+        blockedMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        result.batches++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(300)); // the next sync; the coalescer sends meanwhile
+    }
+    receipts.Stop();
+    result.blockedMs = blockedMs / result.batches;
+    result.requestsPerBatch = static_cast<double>(server.Requests() - requests) / result.batches;
+    return result;
+}
+
+static void RunReceipts(std::FILE* out, const std::vector<long>& rtts, int handshakeRoundTrips, int messages,
+                        std::chrono::milliseconds duration) {
+    std::fprintf(out, "{\n  \"benchmark\": \"read_receipts\",\n  \"duration_ms\": %lld,\n  \"messages_per_batch\": %d,\n  \"results\": [",
+                 (long long)duration.count(), messages);
+    bool first = true;
+    for (long rtt : rtts) {
+        MockHomeserver server;
+        if (!StartServer(server, { std::chrono::milliseconds(rtt), handshakeRoundTrips },
+                         [](const MockRequest&) { return MockResponse{ 200, "{}" }; })) std::exit(1);
+        for (bool coalesce : { false, true }) {
+            ReceiptResult r = RunReceiptCase(server, coalesce, messages, duration);
+            std::fprintf(out,
+                "%s\n    {\"rtt_ms\": %ld, \"receipts\": \"%s\", \"batches\": %zu, \"sync_thread_blocked_ms\": %.3f, "
+                "\"requests_per_batch\": %.1f}",
+                first ? "" : ",", rtt, coalesce ? "coalesced" : "per_message", r.batches, r.blockedMs, r.requestsPerBatch);
+            std::fflush(out);
+            first = false;
+        }
+        server.Stop();
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Fire-and-forget fan-out -----------------
+struct FanoutResult {
+    double submitUs = 0;    // per send
+    double totalMs = 0;     // until every send completed
+    double retainedKb = 0;  // heap held after completion, before shutdown
+    uint64_t threads = 0;   // started
+    size_t peakQueue = 0;
+    uint64_t rejected = 0;
+};
+
+static FanoutResult RunFanoutCase(uint16_t port, bool pool, int sends) {
+    SocketHttpTransport http("127.0.0.1", port, 8);
+    const std::string text(40, 'x');
+    auto send = [&http, text] {
+        http.Request("PUT", "/_matrix/client/r0/rooms/!room:x/send/m.room.message/1",
+                     "{\"msgtype\":\"m.text\",\"body\":\"" + text + "\"}", "tok");
+    };
+
+    FanoutResult result;
+    if (!pool) {
+        // LaunchTask(): a thread per send, the future kept in m_tasks until Stop()
+        std::mutex tasksMutex;
+        std::vector<std::future<void>> tasks;
+        long long base = g_liveBytes.load();
+        auto start = Clock::now();
+        for (int i = 0; i < sends; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(tasksMutex);
+                tasks.emplace_back(std::async(std::launch::async, send));
+            }
+            if (i % 20 == 19) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        result.submitUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / sends;
+        for (auto& task : tasks) task.wait();
+        result.totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        result.retainedKb = (g_liveBytes.load() - base) / 1024.0;
+        result.threads = static_cast<uint64_t>(sends);
+        return result;
+    }
+
+    WorkerPool workers{ 2, 256 };
+    workers.Start();
+    long long base = g_liveBytes.load();
+    auto start = Clock::now();
+    for (int i = 0; i < sends; ++i) {
+        workers.Submit(send);
+        if (i % 20 == 19) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    result.submitUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / sends;
+    WorkerPool::Stats stats;
+    do {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        stats = workers.GetStats();
+    } while (stats.completed + stats.failed < stats.submitted - stats.rejected);
+    result.totalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    result.retainedKb = (g_liveBytes.load() - base) / 1024.0;
+    result.threads = 2;
+    result.peakQueue = stats.peakQueueDepth;
+    result.rejected = stats.rejected;
+    workers.Stop();
+    return result;
+}
+
+static void RunFanout(std::FILE* out, const std::vector<long>& rtts, int handshakeRoundTrips, int sends) {
+    std::fprintf(out, "{\n  \"benchmark\": \"send_fanout\",\n  \"sends\": %d,\n  \"results\": [", sends);
+    bool first = true;
+    for (long rtt : rtts) {
+        MockHomeserver server;
+        if (!StartServer(server, { std::chrono::milliseconds(rtt), handshakeRoundTrips },
+                         [](const MockRequest&) { return MockResponse{ 200, "{\"event_id\":\"$abcdef\"}" }; })) std::exit(1);
+        for (bool pool : { false, true }) {
+            FanoutResult r = RunFanoutCase(server.Port(), pool, sends);
+            std::fprintf(out,
+                "%s\n    {\"rtt_ms\": %ld, \"launcher\": \"%s\", \"submit_us\": %.2f, \"total_ms\": %.1f, "
+                "\"retained_kb\": %.1f, \"threads_started\": %llu, \"peak_queue_depth\": %zu, \"rejected\": %llu}",
+                first ? "" : ",", rtt, pool ? "worker_pool" : "std_async", r.submitUs, r.totalMs, r.retainedKb,
+                (unsigned long long)r.threads, r.peakQueue, (unsigned long long)r.rejected);
+            std::fflush(out);
+            first = false;
+        }
+        server.Stop();
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Send pipeline -----------------
+// Stores PUT /rooms/{room}/send/m.room.message/{txn} like a homeserver: a transaction ID seen
+// before in the room returns the stored event instead of posting again
+class MessageSink {
+public:
+    MockResponse Send(const MockRequest& request) {
+        static const std::string kPrefix = "/_matrix/client/r0/rooms/";
+        size_t send = request.target.find("/send/");
+        if (!request.HasPrefix(kPrefix) || send == std::string::npos) return { 404, "{\"errcode\":\"M_UNRECOGNIZED\"}" };
+        std::string room = request.target.substr(kPrefix.size(), send - kPrefix.size());
+        std::string txn = request.target.substr(request.target.rfind('/') + 1);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_txns.insert(room + "|" + txn).second) {
+            size_t body = request.body.find("\"body\":");
+            m_timelines[room].push_back(body == std::string::npos ? -1 : std::atoi(request.body.c_str() + body + 7));
+        }
+        return { 200, "{\"event_id\":\"$abcdef\"}" };
+    }
+
+    // Messages 0..sent-1 were sent to `room`; counts those missing and those stored out of order
+    void Check(const std::string& room, int sent, int& lost, int& outOfOrder) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const std::vector<int>& timeline = m_timelines[room];
+        lost = sent - static_cast<int>(timeline.size());
+        outOfOrder = 0;
+        for (size_t i = 1; i < timeline.size(); ++i) outOfOrder += timeline[i] < timeline[i - 1];
+    }
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_txns.clear();
+        m_timelines.clear();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::set<std::string> m_txns;
+    std::map<std::string, std::vector<int>> m_timelines;
+};
+
+static std::string MessageContent(int i) { return "{\"msgtype\":\"m.text\",\"body\":" + std::to_string(i) + "}"; }
+
+// Sends `sends` messages to one room, 0 = the old way; returns milliseconds until all completed
+static double RunPipelineCase(uint16_t port, size_t window, int sends, uint64_t& requests) {
+    const std::string room = "!room:x";
+    SocketHttpTransport http("127.0.0.1", port);
+    auto start = Clock::now();
+    if (window == 0) {
+        std::vector<std::future<void>> tasks;
+        for (int i = 0; i < sends; ++i) {
+            tasks.push_back(std::async(std::launch::async, [&http, &room, i] {
+                auto tick = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+                http.Request("PUT", "/_matrix/client/r0/rooms/" + room + "/send/m.room.message/" + std::to_string(tick),
+                             MessageContent(i), "tok");
+            }));
+            if (i % 10 == 9) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (auto& task : tasks) task.wait();
+    } else {
+        WorkerPool workers{ 2, 256 };
+        workers.Start();
+        // Room for every message: typing outpaces the sends, and the bench measures throughput,
+        // not the queue bound
+        SendPipeline pipeline(http, workers, window, std::max<size_t>(256, sends));
+        pipeline.SetAccessToken("tok");
+        for (int i = 0; i < sends; ++i) {
+            if (pipeline.Send(room, MessageContent(i)).empty()) {
+                std::fprintf(stderr, "SendPipeline refused message %d\n", i);
+                std::exit(1);
+            }
+            if (i % 10 == 9) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        SendPipeline::Stats stats;
+        do {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            stats = pipeline.GetStats();
+        } while (stats.sent + stats.failed < static_cast<uint64_t>(sends));
+        pipeline.Stop();
+        workers.Stop();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    requests = http.GetStats().requests;
+    return ms;
+}
+
+static void RunPipeline(std::FILE* out, const std::vector<long>& rtts, int handshakeRoundTrips, int sends,
+                        const std::vector<long>& windows) {
+    std::fprintf(out, "{\n  \"benchmark\": \"send_pipeline\",\n  \"sends\": %d,\n  \"results\": [", sends);
+    bool first = true;
+    for (long rtt : rtts) {
+        MessageSink sink;
+        MockHomeserver server;
+        if (!StartServer(server, { std::chrono::milliseconds(rtt), handshakeRoundTrips },
+                         [&sink](const MockRequest& request) { return sink.Send(request); })) std::exit(1);
+        std::vector<long> cases = { 0 };
+        cases.insert(cases.end(), windows.begin(), windows.end());
+        for (long window : cases) {
+            sink.Reset();
+            uint64_t requests = 0;
+            double ms = RunPipelineCase(server.Port(), static_cast<size_t>(window), sends, requests);
+            int lost = 0, outOfOrder = 0;
+            sink.Check("!room:x", sends, lost, outOfOrder);
+            std::fprintf(out,
+                "%s\n    {\"rtt_ms\": %ld, \"sender\": \"%s\", \"window\": %ld, \"total_ms\": %.1f, \"msgs_per_sec\": %.1f, "
+                "\"requests\": %llu, \"lost\": %d, \"out_of_order\": %d}",
+                first ? "" : ",", rtt, window ? "send_pipeline" : "std_async", window, ms, sends * 1000.0 / ms,
+                (unsigned long long)requests, lost, outOfOrder);
+            std::fflush(out);
+            first = false;
+        }
+        server.Stop();
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Cold start -----------------
+// The homeserver's view of the user: --rooms joined rooms, each with 30 members and 20 messages,
+// of which the last session stored everything; since then three more arrived in the first room
+static const char* const kResumedRoom = "!room0:matrix.org";
+
+static std::string ColdStartEvent(int room, int i) {
+    return "{\"type\":\"m.room.message\",\"sender\":\"@peer:matrix.org\",\"event_id\":\"$r" + std::to_string(room) + "e" +
+           std::to_string(i) + "\",\"origin_server_ts\":" + std::to_string(1700000000000ull + i) +
+           ",\"content\":{\"msgtype\":\"m.text\",\"body\":\"hello there, message body text\"}}";
+}
+
+static std::string ColdStartSync(const char* nextBatch, int rooms, int from, int count) {
+    std::string body = std::string("{\"next_batch\":\"") + nextBatch + "\",\"rooms\":{\"join\":{";
+    for (int r = 0; r < rooms; ++r) {
+        body += (r ? ",\"!room" : "\"!room") + std::to_string(r) + ":matrix.org\":{\"state\":{\"events\":[";
+        for (int m = 0; from == 0 && m < 30; ++m)
+            body += (m ? ",{\"type\":\"m.room.member\",\"state_key\":\"@u" : "{\"type\":\"m.room.member\",\"state_key\":\"@u") +
+                    std::to_string(m) + ":matrix.org\",\"content\":{\"membership\":\"join\"}}";
+        body += "]},\"timeline\":{\"events\":[";
+        for (int i = from; i < from + count; ++i) body += (i > from ? "," : "") + ColdStartEvent(r, i);
+        body += "],\"limited\":false}}";
+    }
+    return body + "}}}";
+}
+
+struct ColdStartResult {
+    double historyMs = -1;  // stored messages of the room on screen
+    double firstNewMs = -1; // first message that arrived since the last session on screen
+    uint64_t requests = 0;
+    uint64_t connections = 0;
+};
+
+static bool IsUser(const HttpResponse& whoami) {
+    JsonIndex index;
+    return whoami.status == 200 && index.Build(whoami.body) && JsonIndex::Unescape(index.Find("user_id")) == "@me:matrix.org";
+}
+
+// Before: PerformLogin's blocking whoami, PromptRoomChoice's join, then SyncLoop's initial sync on
+// its own connection; nothing was kept from the last session
+static ColdStartResult RunSequentialStart(MockHomeserver& server) {
+    ColdStartResult result;
+    const uint64_t requests = server.Requests();
+    const size_t connections = server.Connections();
+    auto start = Clock::now();
+    SocketHttpTransport http("127.0.0.1", server.Port()), syncHttp("127.0.0.1", server.Port());
+    if (!IsUser(http.Request("GET", "/_matrix/client/r0/account/whoami", "", "tok"))) return result;
+    http.Request("POST", "/_matrix/client/r0/join/%23room0:matrix.org", "{}", "tok");
+    HttpResponse synced = syncHttp.Request("GET", "/_matrix/client/r0/sync?timeout=0&filter=1", "", "tok");
+
+    SyncBatch batch;
+    ParseSync(synced.body, [](std::string_view) { return true; }, batch);
+    RoomTimelines timelines;
+    for (const SyncTimelineEvent& e : batch.events) timelines.Append(e.roomId, { e.eventId, e.sender, e.body, e.originServerTs });
+    bool shown = false;
+    timelines.SetActive(kResumedRoom, [&shown](const RoomMessage&) { shown = true; });
+    if (shown) result.historyMs = result.firstNewMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    result.requests = server.Requests() - requests;
+    result.connections = server.Connections() - connections;
+    return result;
+}
+
+// After: MatrixClient::ResumeSession with the stored sync token (none if `since` is empty) and
+// the timeline store in `dir`
+static ColdStartResult RunResumedStart(MockHomeserver& server, const std::string& since, const std::filesystem::path& dir) {
+    ColdStartResult result;
+    const uint64_t requests = server.Requests();
+    const size_t connections = server.Connections();
+    auto start = Clock::now();
+    SocketHttpTransport http("127.0.0.1", server.Port());
+    auto join = std::async(std::launch::async, [&http] {
+        return http.Request("POST", "/_matrix/client/r0/join/%23room0:matrix.org", "{}", "tok");
+    });
+    auto sync = std::async(std::launch::async, [&http, &since] {
+        return http.Request("GET", "/_matrix/client/r0/sync?timeout=0&filter=1" + (since.empty() ? "" : "&since=" + since), "", "tok");
+    });
+    TimelineStore store;
+    store.Open(dir);
+    HttpResponse whoami = http.Request("GET", "/_matrix/client/r0/account/whoami", "", "tok");
+    HttpResponse joined = join.get();
+    HttpResponse synced = sync.get();
+    if (!IsUser(whoami)) return result;
+
+    // Stored history first, then what arrived since, minus what the store already has
+    RoomTimelines timelines;
+    for (const std::string& room : store.Rooms())
+        store.ForEachRecent(room, timelines.Capacity(), [&](const TimelineRecord& r) {
+            timelines.Append(room, { std::string(r.eventId), std::string(r.sender), std::string(r.body), r.originServerTs });
+        });
+    SyncBatch batch;
+    ParseSync(synced.body, [](std::string_view) { return true; }, batch);
+    size_t fresh = 0;
+    for (const SyncTimelineEvent& e : batch.events) {
+        if (!store.Append(e.roomId, e.eventId, e.sender, e.body, e.originServerTs)) continue;
+        timelines.Append(e.roomId, { e.eventId, e.sender, e.body, e.originServerTs });
+        if (e.roomId == kResumedRoom) ++fresh;
+    }
+    JsonIndex index;
+    index.Build(joined.body);
+    size_t shown = 0;
+    timelines.SetActive(JsonIndex::Unescape(index.Find("room_id")), [&shown](const RoomMessage&) { ++shown; });
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (shown > fresh) result.historyMs = ms;
+    if (fresh) result.firstNewMs = ms;
+    result.requests = server.Requests() - requests;
+    result.connections = server.Connections() - connections;
+    return result;
+}
+
+static void RunColdStart(std::FILE* out, const std::vector<long>& rtts, int handshakeRoundTrips, int rooms, int runs) {
+    namespace fs = std::filesystem;
+    const std::string initialSync = ColdStartSync("s1", rooms, 0, 20);
+    const std::string incrementalSync = ColdStartSync("s2", 1, 20, 3);
+
+    // What the last session stored: everything the initial sync returned
+    const fs::path dir = fs::temp_directory_path() / "TalksterColdStartBench";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    {
+        TimelineStore store;
+        store.Open(dir / "stored");
+        SyncBatch batch;
+        ParseSync(initialSync, [](std::string_view) { return true; }, batch);
+        for (const SyncTimelineEvent& e : batch.events) store.Append(e.roomId, e.eventId, e.sender, e.body, e.originServerTs);
+    }
+
+    std::fprintf(out,
+        "{\n  \"benchmark\": \"cold_start\",\n  \"handshake_rtts\": %d,\n  \"rooms\": %d,\n  \"initial_sync_kb\": %.1f,\n"
+        "  \"runs\": %d,\n  \"results\": [",
+        handshakeRoundTrips, rooms, initialSync.size() / 1024.0, runs);
+    bool first = true;
+    for (long rtt : rtts) {
+        MockHomeserver server;
+        if (!StartServer(server, { std::chrono::milliseconds(rtt), handshakeRoundTrips },
+                         [&](const MockRequest& request) {
+                             using std::chrono::milliseconds;
+                             if (request.HasPrefix("/_matrix/client/r0/account/whoami"))
+                                 return MockResponse{ 200, "{\"user_id\":\"@me:matrix.org\"}", milliseconds(5) };
+                             if (request.HasPrefix("/_matrix/client/r0/join/"))
+                                 return MockResponse{ 200, "{\"room_id\":\"!room0:matrix.org\"}", milliseconds(40) };
+                             if (!request.Query("since").empty())
+                                 return MockResponse{ 200, incrementalSync, milliseconds(15) };
+                             return MockResponse{ 200, initialSync, milliseconds(600) };
+                         })) std::exit(1);
+
+        for (const char* path : { "sequential", "resumed", "resumed_no_token" }) {
+            std::vector<double> historyMs, firstNewMs;
+            ColdStartResult r;
+            for (int run = 0; run < runs; ++run) {
+                const std::string name = path;
+                if (name == "sequential") {
+                    r = RunSequentialStart(server);
+                } else {
+                    // Each run resumes from a fresh copy of the stored logs, or from none
+                    fs::remove_all(dir / "run", ec);
+                    if (name == "resumed") fs::copy(dir / "stored", dir / "run");
+                    r = RunResumedStart(server, name == "resumed" ? "s1" : "", dir / "run");
+                }
+                if (r.firstNewMs < 0) {
+                    std::fprintf(stderr, "%s start showed no new message\n", path);
+                    std::exit(1);
+                }
+                historyMs.push_back(r.historyMs);
+                firstNewMs.push_back(r.firstNewMs);
+            }
+            // No stored history to show without a store
+            char history[32] = "null";
+            if (r.historyMs >= 0) std::snprintf(history, sizeof(history), "%.1f", Percentile(historyMs, 0.50));
+            std::fprintf(out,
+                "%s\n    {\"rtt_ms\": %ld, \"path\": \"%s\", \"history_ms_p50\": %s, \"first_new_message_ms_p50\": %.1f, "
+                "\"requests\": %llu, \"connections\": %llu}",
+                first ? "" : ",", rtt, path, history, Percentile(firstNewMs, 0.50),
+                (unsigned long long)r.requests, (unsigned long long)r.connections);
+            std::fflush(out);
+            first = false;
+        }
+        server.Stop();
+    }
+    fs::remove_all(dir, ec);
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Command line -----------------
+static std::vector<long> ParseList(const char* s) {
+    std::vector<long> out;
+    for (const char* p = s; *p;) {
+        char* end;
+        out.push_back(std::strtol(p, &end, 10));
+        p = *end == ',' ? end + 1 : end;
+        if (end == p && *p) break;
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::string bench = "keepalive";
+    long durationMs = 0;
+    std::vector<long> rtts;
+    int handshakeRoundTrips = 2;
+    int messages = 50;
+    int sends = 0;
+    std::vector<long> windows = { 1, 4, 8, 16 };
+    int rooms = 20;
+    int runs = 5;
+    const char* outPath = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--bench") bench = argv[i + 1];
+        else if (arg == "--duration-ms") durationMs = std::strtol(argv[i + 1], nullptr, 10);
+        else if (arg == "--rtt-ms") rtts = ParseList(argv[i + 1]);
+        else if (arg == "--handshake-rtts") handshakeRoundTrips = (int)std::strtol(argv[i + 1], nullptr, 10);
+        else if (arg == "--messages") messages = std::max(1, (int)std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--sends") sends = std::max(1, (int)std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--windows") windows = ParseList(argv[i + 1]);
+        else if (arg == "--rooms") rooms = std::max(1, (int)std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--runs") runs = std::max(1, (int)std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--out") outPath = argv[i + 1];
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (bench != "keepalive" && bench != "arrival" && bench != "receipts" && bench != "fanout" &&
+        bench != "pipeline" && bench != "coldstart") {
+        std::fprintf(stderr, "unknown benchmark %s\n", bench.c_str());
+        return 2;
+    }
+    if (rtts.empty()) {
+        if (bench == "fanout") rtts = { 0 };
+        else if (bench == "pipeline") rtts = { 20 };
+        else if (bench == "coldstart") rtts = { 50 };
+        else rtts = { 0, 20 };
+    }
+    if (sends <= 0) sends = bench == "pipeline" ? 200 : 10000;
+    if (durationMs <= 0) durationMs = bench == "arrival" ? 5000 : 2000;
+    const std::chrono::milliseconds duration(durationMs);
+
+    std::FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", outPath);
+        return 1;
+    }
+
+    if (bench == "arrival") RunArrival(out, rtts, handshakeRoundTrips, duration);
+    else if (bench == "receipts") RunReceipts(out, rtts, handshakeRoundTrips, messages, duration);
+    else if (bench == "fanout") RunFanout(out, rtts, handshakeRoundTrips, sends);
+    else if (bench == "pipeline") RunPipeline(out, rtts, handshakeRoundTrips, sends, windows);
+    else if (bench == "coldstart") RunColdStart(out, rtts, handshakeRoundTrips, rooms, runs);
+    else RunKeepAlive(out, rtts, handshakeRoundTrips, duration);
+
+    if (outPath) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,491 @@
+// JSON benchmarks for the client-server API bodies MatrixClient reads and writes. Prints one JSON
+// document for the benchmark chosen with --bench:
+//
+//   sync   /sync extraction with the SAX ParseSync against the DOM path it replaced (parse the
+//          whole body with nlohmann::json, copy rooms.join, walk the current room's timeline):
+//          time per parse and peak heap per parse, on generated fixtures from an incremental sync
+//          to a large initial one, or on recorded bodies given with --fixtures
+//   writer m.room.message request bodies built by string concatenation (as before), with
+//          nlohmann::json::dump and with JsonWriter into a fresh and into a reused buffer:
+//          time and heap allocations per body, and whether the result is valid JSON, for chat
+//          text from one line to an 8 KB paste and text full of quotes and newlines
+//   index  field lookup in login, join and createRoom responses and in a /sync-sized document:
+//          ExtractJsonValue (as before) against nlohmann parsing and JsonIndex, with and without
+//          copying the values out, and whether each found the right values
+//
+//   JsonBench [--bench sync|writer|index] [--duration-ms 1000] [--fixtures a.json,b.json] [--out results.json]
+#include "JsonIndex.h"
+#include "JsonWriter.h"
+#include "SyncParser.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using json = nlohmann::json;
+
+static volatile size_t g_sink; // keeps the measured results alive
+
+// ----------------- Heap accounting -----------------
+// Every allocation carries its size in front, so the bytes live at any moment are known
+static std::atomic<long long> g_liveBytes{ 0 };
+static std::atomic<long long> g_peakBytes{ 0 };
+static std::atomic<uint64_t> g_allocations{ 0 };
+
+static void* Allocate(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    long long live = g_liveBytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed) + static_cast<long long>(size);
+    long long peak = g_peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    auto* p = static_cast<size_t*>(std::malloc(size + 16));
+    if (!p) throw std::bad_alloc();
+    *p = size;
+    return p + 2;
+}
+
+static void Release(void* p) {
+    if (!p) return;
+    auto* header = static_cast<size_t*>(p) - 2;
+    g_liveBytes.fetch_sub(static_cast<long long>(*header), std::memory_order_relaxed);
+    std::free(header);
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void operator delete(void* p) noexcept { Release(p); }
+void operator delete[](void* p) noexcept { Release(p); }
+void operator delete(void* p, size_t) noexcept { Release(p); }
+void operator delete[](void* p, size_t) noexcept { Release(p); }
+
+// Peak heap growth while `body` runs, in bytes
+template <typename F>
+static long long PeakBytes(F&& body) {
+    long long base = g_liveBytes.load();
+    g_peakBytes = base;
+    body();
+    return g_peakBytes.load() - base;
+}
+
+// Average milliseconds per call of `body` over at least `duration` (and at least 3 calls)
+template <typename F>
+static double MillisPerCall(std::chrono::milliseconds duration, F&& body) {
+    uint64_t calls = 0;
+    auto start = Clock::now();
+    do {
+        body();
+        calls++;
+    } while (Clock::now() - start < duration || calls < 3);
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / calls;
+}
+
+// ----------------- /sync extraction -----------------
+struct SyncFixture {
+    std::string name;
+    std::string body;
+    std::string room; // the room on screen
+};
+
+static std::string MakeSync(int rooms, int events, int stateEvents, int presence) {
+    json j;
+    j["next_batch"] = "s12345_67890";
+    for (int p = 0; p < presence; ++p) {
+        j["presence"]["events"].push_back({ { "type", "m.presence" }, { "sender", "@u" + std::to_string(p) + ":matrix.org" },
+                                            { "content", { { "presence", "online" }, { "last_active_ago", 1000 * p } } } });
+    }
+    for (int r = 0; r < rooms; ++r) {
+        auto& room = j["rooms"]["join"]["!room" + std::to_string(r) + ":matrix.org"];
+        for (int s = 0; s < stateEvents; ++s) {
+            std::string member = "@m" + std::to_string(s) + ":matrix.org";
+            room["state"]["events"].push_back({ { "type", "m.room.member" }, { "state_key", member }, { "sender", member },
+                { "content", { { "membership", "join" }, { "displayname", "Member " + std::to_string(s) },
+                               { "avatar_url", "mxc://matrix.org/abcdefghijklmnop" } } },
+                { "event_id", "$st" + std::to_string(r) + "_" + std::to_string(s) }, { "origin_server_ts", 1700000000000ull + s } });
+        }
+        for (int e = 0; e < events; ++e) {
+            room["timeline"]["events"].push_back({ { "type", "m.room.message" }, { "sender", "@u" + std::to_string(e % 7) + ":matrix.org" },
+                { "content", { { "msgtype", "m.text" }, { "body", "message number " + std::to_string(e) + " with some text \xC3\xA9 \"quoted\"" } } },
+                { "event_id", "$ev" + std::to_string(r) + "_" + std::to_string(e) }, { "origin_server_ts", 1700000000000ull + e },
+                { "unsigned", { { "age", 1234 } } } });
+        }
+        room["timeline"]["limited"] = true;
+        room["timeline"]["prev_batch"] = "p1";
+        room["unread_notifications"] = { { "highlight_count", 0 }, { "notification_count", events } };
+        room["ephemeral"]["events"] = json::array({ { { "type", "m.typing" }, { "content", { { "user_ids", json::array() } } } } });
+    }
+    j["account_data"]["events"] = json::array({ { { "type", "m.push_rules" }, { "content", { { "global", { { "override", json::array() } } } } } } });
+    return j.dump();
+}
+
+// What SyncOnce did before ParseSync
+static size_t DomExtract(const std::string& body, const std::string& roomId, std::string& nextBatch) {
+    json j = json::parse(body);
+    nextBatch = j.value("next_batch", "");
+    if (!j.contains("rooms") || !j["rooms"].contains("join")) return 0;
+    json joinObj = j["rooms"]["join"];
+    if (!joinObj.contains(roomId)) return 0;
+    size_t messages = 0;
+    for (const auto& ev : joinObj[roomId]["timeline"]["events"]) {
+        if (ev.value("type", "") != "m.room.message") continue;
+        std::string text = ev["content"].value("body", "");
+        messages += !text.empty();
+    }
+    return messages;
+}
+
+static size_t SaxExtract(const std::string& body, const std::string& roomId, std::string& nextBatch) {
+    SyncBatch batch;
+    if (!ParseSync(body, [&roomId](std::string_view room) { return room == roomId; }, batch)) return 0;
+    nextBatch = std::move(batch.nextBatch);
+    size_t messages = 0;
+    for (const auto& ev : batch.events) messages += ev.type == "m.room.message" && !ev.body.empty();
+    return messages;
+}
+
+// The first joined room of a recorded body, as the room on screen
+static std::string FirstJoinedRoom(const std::string& body) {
+    SyncBatch batch;
+    ParseSync(body, [](std::string_view) { return true; }, batch);
+    return batch.events.empty() ? std::string() : batch.events.front().roomId;
+}
+
+static void RunSync(std::FILE* out, const std::vector<std::string>& fixturePaths, std::chrono::milliseconds duration) {
+    std::vector<SyncFixture> fixtures;
+    if (fixturePaths.empty()) {
+        fixtures.push_back({ "incremental_1_room", MakeSync(1, 5, 0, 2), "!room0:matrix.org" });
+        fixtures.push_back({ "busy_50_rooms", MakeSync(50, 20, 10, 50), "!room0:matrix.org" });
+        fixtures.push_back({ "initial_300_rooms", MakeSync(300, 50, 100, 200), "!room0:matrix.org" });
+    }
+    for (const auto& path : fixturePaths) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        if (!in) {
+            std::fprintf(stderr, "cannot read %s\n", path.c_str());
+            std::exit(1);
+        }
+        std::string body = ss.str();
+        std::string room = FirstJoinedRoom(body);
+        fixtures.push_back({ path, std::move(body), std::move(room) });
+    }
+
+    std::fprintf(out, "{\n  \"benchmark\": \"sync_parse\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+                 (long long)duration.count());
+    bool first = true;
+    for (const auto& f : fixtures) {
+        std::string domBatch, saxBatch;
+        size_t domMessages = DomExtract(f.body, f.room, domBatch);
+        size_t saxMessages = SaxExtract(f.body, f.room, saxBatch);
+        if (domMessages != saxMessages || domBatch != saxBatch) {
+            std::fprintf(stderr, "%s: SAX and DOM disagree (%zu vs %zu messages)\n", f.name.c_str(), saxMessages, domMessages);
+            std::exit(1);
+        }
+        std::string sink;
+        long long domPeak = PeakBytes([&] { DomExtract(f.body, f.room, sink); });
+        long long saxPeak = PeakBytes([&] { SaxExtract(f.body, f.room, sink); });
+        double domMs = MillisPerCall(duration, [&] { DomExtract(f.body, f.room, sink); });
+        double saxMs = MillisPerCall(duration, [&] { SaxExtract(f.body, f.room, sink); });
+        std::fprintf(out,
+            "%s\n    {\"fixture\": \"%s\", \"body_kb\": %.1f, \"messages\": %zu, "
+            "\"dom\": {\"ms\": %.3f, \"peak_heap_kb\": %.1f}, \"sax\": {\"ms\": %.3f, \"peak_heap_kb\": %.1f}}",
+            first ? "" : ",", f.name.c_str(), f.body.size() / 1024.0, saxMessages,
+            domMs, domPeak / 1024.0, saxMs, saxPeak / 1024.0);
+        std::fflush(out);
+        first = false;
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Request body encoding -----------------
+
+struct WriterCase {
+    const char* name;
+    std::string text;
+};
+
+static std::vector<WriterCase> WriterCases() {
+    std::vector<WriterCase> cases = {
+        { "chat_line", "gg wp, that last round was close! brb 5 min" },
+        { "paragraph", std::string(460, ' ') },
+        { "paste_8k", std::string(8192, ' ') },
+        { "escape_heavy", std::string(400, ' ') },
+    };
+    for (size_t i = 0; i < cases[1].text.size(); ++i) cases[1].text[i] = " etaoinshrdlu"[i % 13];
+    for (size_t i = 0; i < cases[2].text.size(); ++i) cases[2].text[i] = i % 97 == 0 ? '\n' : i % 211 == 0 ? '"' : char('a' + i % 26);
+    for (size_t i = 0; i < cases[3].text.size(); ++i) cases[3].text[i] = i % 4 == 0 ? '"' : i % 4 == 1 ? '\n' : 'x';
+    return cases;
+}
+
+// Nanoseconds and allocations per call of `encode`, which returns the body
+template <typename F>
+static void MeasureEncoder(std::chrono::milliseconds duration, F&& encode, double& ns, double& allocations, bool& valid) {
+    valid = json::accept(encode());
+    size_t sink = 0;
+    uint64_t calls = 0;
+    uint64_t allocationsBefore = g_allocations.load();
+    auto start = Clock::now();
+    do {
+        for (int i = 0; i < 256; ++i) sink += encode().size();
+        calls += 256;
+    } while (Clock::now() - start < duration);
+    ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+    allocations = static_cast<double>(g_allocations.load() - allocationsBefore) / calls;
+    g_sink = sink;
+}
+
+static void RunWriter(std::FILE* out, std::chrono::milliseconds duration) {
+    std::fprintf(out, "{\n  \"benchmark\": \"request_encoding\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+                 (long long)duration.count());
+    bool first = true;
+    std::string reused;
+    for (const auto& c : WriterCases()) {
+        const std::string& text = c.text;
+        auto concatenation = [&text] { return std::string("{\"msgtype\":\"m.text\",\"body\":\"" + text + "\"}"); };
+        auto dump = [&text] {
+            json j = { { "msgtype", "m.text" }, { "body", text } };
+            return j.dump();
+        };
+        auto fresh = [&text] {
+            std::string body;
+            JsonWriter(body).BeginObject().Field("msgtype", "m.text").Field("body", text).EndObject();
+            return body;
+        };
+        auto reuse = [&text, &reused]() -> const std::string& {
+            JsonWriter(reused).BeginObject().Field("msgtype", "m.text").Field("body", text).EndObject();
+            return reused;
+        };
+
+        struct Row {
+            const char* encoder;
+            double ns = 0, allocations = 0;
+            bool valid = false;
+        } rows[4] = { { "concatenation" }, { "nlohmann_dump" }, { "json_writer" }, { "json_writer_reused" } };
+        MeasureEncoder(duration, concatenation, rows[0].ns, rows[0].allocations, rows[0].valid);
+        MeasureEncoder(duration, dump, rows[1].ns, rows[1].allocations, rows[1].valid);
+        MeasureEncoder(duration, fresh, rows[2].ns, rows[2].allocations, rows[2].valid);
+        MeasureEncoder(duration, reuse, rows[3].ns, rows[3].allocations, rows[3].valid);
+        for (const Row& r : rows) {
+            std::fprintf(out,
+                "%s\n    {\"text\": \"%s\", \"text_bytes\": %zu, \"encoder\": \"%s\", \"ns\": %.1f, \"mb_per_sec\": %.0f, "
+                "\"allocations\": %.2f, \"valid_json\": %s}",
+                first ? "" : ",", c.name, text.size(), r.encoder, r.ns, text.size() / r.ns * 1000, r.allocations,
+                r.valid ? "true" : "false");
+            first = false;
+        }
+        std::fflush(out);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Field lookup -----------------
+// MatrixClient::ExtractJsonValue before JsonIndex
+static std::string ExtractJsonValue(const std::string& json, const std::string& key) {
+    std::string pattern = "\"" + key + "\":";
+    auto pos = json.find(pattern);
+    if (pos == std::string::npos) return {};
+    pos += pattern.size();
+    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t')) pos++;
+    if (pos < json.size() && json[pos] == '"') {
+        pos++;
+        std::string value;
+        bool escape = false;
+        for (; pos < json.size(); ++pos) {
+            char c = json[pos];
+            if (escape) {
+                value.push_back(c);
+                escape = false;
+            } else if (c == '\\') {
+                escape = true;
+            } else if (c == '"') {
+                break;
+            } else {
+                value.push_back(c);
+            }
+        }
+        return value;
+    }
+    size_t end = json.find_first_of(",}\n", pos);
+    if (end == std::string::npos) end = json.size();
+    return json.substr(pos, end - pos);
+}
+
+struct IndexCase {
+    const char* name;
+    std::string body;
+    std::vector<std::string> keys; // top-level string fields, at most two
+};
+
+static std::vector<IndexCase> IndexCases() {
+    std::vector<IndexCase> cases = {
+        { "login",
+          R"({"user_id":"@alice:matrix.org","access_token":"syt_YWxpY2U_ZkRsWmVyTnBqVGdKSlJxUEZ3bGs_1a2b3c","home_server":"matrix.org",)"
+          R"("device_id":"QWERTYUIOP","well_known":{"m.homeserver":{"base_url":"https://matrix-client.matrix.org/"}}})",
+          { "access_token", "user_id" } },
+        { "join", R"({"room_id":"!AbCdEfGhIjKlMnOpQr:matrix.org"})", { "room_id" } },
+        { "create_room", R"({"room_id":"!AbCdEfGhIjKlMnOpQr:matrix.org","room_alias":"#room_1729876543210:matrix.org"})", { "room_id" } },
+        // A server that writes a space before the colon, and a nested key of the same name first
+        { "join_spaced", R"({"room_id" : "!AbCdEfGhIjKlMnOpQr:matrix.org"})", { "room_id" } },
+        { "login_nested_first",
+          R"({"well_known":{"m.identity_server":{"user_id":"@wrong:x"}},"user_id":"@alice:matrix.org","access_token":"syt_abc"})",
+          { "access_token", "user_id" } },
+    };
+    json big = json::object();
+    for (int r = 0; r < 2000; ++r) {
+        auto& events = big["rooms"]["join"]["!room" + std::to_string(r) + ":x"]["timeline"]["events"];
+        for (int e = 0; e < 20; ++e) {
+            events.push_back({ { "type", "m.room.message" }, { "sender", "@u:x" },
+                               { "content", { { "msgtype", "m.text" }, { "body", "hello \"world\" with {braces} and [brackets], ok?" } } } });
+        }
+    }
+    big["zz_next_batch"] = "s72594_4483_1934"; // serialized last
+    cases.push_back({ "sync_5mb", big.dump(), { "zz_next_batch" } });
+    return cases;
+}
+
+// Nanoseconds per call of `body` over at least `duration`
+template <typename F>
+static double NanosPerCall(std::chrono::milliseconds duration, F&& body) {
+    uint64_t calls = 0;
+    auto start = Clock::now();
+    do {
+        for (int i = 0; i < 16; ++i) body();
+        calls += 16;
+    } while (Clock::now() - start < duration);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+}
+
+static void RunIndex(std::FILE* out, std::chrono::milliseconds duration) {
+    std::fprintf(out, "{\n  \"benchmark\": \"field_lookup\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+                 (long long)duration.count());
+    bool first = true;
+    JsonIndex reused;
+    for (const auto& c : IndexCases()) {
+        std::vector<std::string> expected;
+        json parsed = json::parse(c.body);
+        for (const auto& key : c.keys) expected.push_back(parsed[key].get<std::string>());
+        // Fills `values` from a built index; the views alone are what MatrixClient keeps for
+        // fields it only compares
+        auto lookupIndex = [&c](const JsonIndex& index, std::string_view* found) {
+            if (c.keys.size() == 2) index.Lookup({ c.keys[0], c.keys[1] }, found);
+            else index.Lookup({ c.keys[0] }, found);
+        };
+        using Lookup = std::function<void(std::vector<std::string>&)>;
+        const Lookup lookups[4] = {
+            [&c](std::vector<std::string>& values) {
+                for (size_t i = 0; i < c.keys.size(); ++i) values[i] = ExtractJsonValue(c.body, c.keys[i]);
+            },
+            [&c](std::vector<std::string>& values) {
+                json j = json::parse(c.body);
+                for (size_t i = 0; i < c.keys.size(); ++i) values[i] = j.value(c.keys[i], "");
+            },
+            [&](std::vector<std::string>& values) {
+                JsonIndex index;
+                index.Build(c.body);
+                std::string_view found[2];
+                lookupIndex(index, found);
+                for (size_t i = 0; i < c.keys.size(); ++i) values[i] = JsonIndex::Unescape(found[i]);
+            },
+            [&](std::vector<std::string>& values) {
+                reused.Build(c.body);
+                std::string_view found[2];
+                lookupIndex(reused, found);
+                for (size_t i = 0; i < c.keys.size(); ++i) values[i] = JsonIndex::Unescape(found[i]);
+            },
+        };
+
+        struct Row {
+            const char* method;
+            double ns = 0;
+            bool correct = false;
+        } rows[4] = { { "extract_json_value" }, { "nlohmann_parse" }, { "json_index" }, { "json_index_views" } };
+        std::vector<std::string> values(c.keys.size());
+        size_t sink = 0;
+        for (int m = 0; m < 3; ++m) {
+            lookups[m](values);
+            rows[m].correct = values == expected;
+            rows[m].ns = NanosPerCall(duration, [&] {
+                lookups[m](values);
+                sink += values[0].size();
+            });
+        }
+        lookups[3](values);
+        rows[3].correct = values == expected;
+        rows[3].ns = NanosPerCall(duration, [&] {
+            reused.Build(c.body);
+            std::string_view found[2];
+            lookupIndex(reused, found);
+            sink += found[0].size();
+        });
+        g_sink = sink;
+
+        for (const Row& r : rows) {
+            std::fprintf(out,
+                "%s\n    {\"response\": \"%s\", \"bytes\": %zu, \"fields\": %zu, \"method\": \"%s\", \"ns\": %.1f, \"correct\": %s}",
+                first ? "" : ",", c.name, c.body.size(), c.keys.size(), r.method, r.ns, r.correct ? "true" : "false");
+            first = false;
+        }
+        std::fflush(out);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Command line -----------------
+static std::vector<std::string> SplitList(const char* s) {
+    std::vector<std::string> out;
+    std::string item;
+    for (const char* p = s;; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) out.push_back(item);
+            item.clear();
+            if (!*p) break;
+        } else {
+            item += *p;
+        }
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::string bench = "sync";
+    long durationMs = 1000;
+    std::vector<std::string> fixtures;
+    const char* outPath = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--bench") bench = argv[i + 1];
+        else if (arg == "--duration-ms") durationMs = std::strtol(argv[i + 1], nullptr, 10);
+        else if (arg == "--fixtures") fixtures = SplitList(argv[i + 1]);
+        else if (arg == "--out") outPath = argv[i + 1];
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (bench != "sync" && bench != "writer" && bench != "index") {
+        std::fprintf(stderr, "unknown benchmark %s\n", bench.c_str());
+        return 2;
+    }
+    const std::chrono::milliseconds duration(durationMs);
+
+    std::FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", outPath);
+        return 1;
+    }
+
+    if (bench == "writer") RunWriter(out, duration);
+    else if (bench == "index") RunIndex(out, duration);
+    else RunSync(out, fixtures, duration);
+
+    if (outPath) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include "SocketCompat.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct MockRequest {
+    std::string method;
+    std::string target; // path and query string
+    std::string body;
+    std::string bearerToken;
+
+    // Value of `key` in the query string, empty when absent
+    std::string Query(std::string_view key) const {
+        size_t q = target.find('?');
+        for (size_t p = q; p != std::string::npos && p < target.size(); p = target.find('&', p)) {
+            ++p;
+            if (target.compare(p, key.size(), key) == 0 && p + key.size() < target.size() && target[p + key.size()] == '=') {
+                size_t start = p + key.size() + 1;
+                return target.substr(start, target.find('&', start) - start);
+            }
+        }
+        return {};
+    }
+    bool HasPrefix(std::string_view prefix) const { return target.compare(0, prefix.size(), prefix) == 0; }
+};
+
+struct MockResponse {
+    int status = 200;                    // 0: the connection is cut instead of answering
+    std::string body;
+    std::chrono::milliseconds work{ 0 }; // server time on top of the round-trip
+};
+
+// In-process loopback HTTP/1.1 homeserver for the benchmarks: keep-alive, one reader and one writer
+// thread per connection, every request answered by the handler. A simulated network delay can be
+// set: each response leaves one round-trip plus its work after its request arrived, so pipelined
+// requests overlap as they would over a real link, and every new connection first costs a number
+// of round-trips for the TCP and TLS handshakes. The handler runs on the connection's reader
+// thread and may block, e.g. to hold a long poll.
+class MockHomeserver {
+public:
+    using Handler = std::function<MockResponse(const MockRequest&)>;
+
+    // Must be called before Start()
+    void SetHandler(Handler handler) { m_handler = std::move(handler); }
+    void SetRoundTrip(std::chrono::milliseconds rtt) { m_rtt = rtt; }
+    void SetHandshakeRoundTrips(int count) { m_handshakeRoundTrips = count; }
+
+    bool Start() {
+        Net::Startup();
+        m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listen == INVALID_SOCKET) return false;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(m_listen, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listen, SOMAXCONN) != 0 ||
+            getsockname(m_listen, (sockaddr*)&addr, &len) != 0) return false;
+        m_port = ntohs(addr.sin_port);
+
+        m_acceptThread = std::thread([this] {
+            for (;;) {
+                SOCKET s = accept(m_listen, nullptr, nullptr);
+                if (s == INVALID_SOCKET) return;
+                m_connections++;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_sockets.push_back(s);
+                m_workers.emplace_back(&MockHomeserver::Serve, this, s);
+            }
+        });
+        return true;
+    }
+
+    // Handlers blocked in a long poll must have been released first
+    void Stop() {
+        shutdown(m_listen, SD_BOTH);
+        closesocket(m_listen);
+        if (m_acceptThread.joinable()) m_acceptThread.join();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (SOCKET s : m_sockets) shutdown(s, SD_BOTH);
+        }
+        for (auto& t : m_workers) t.join();
+    }
+
+    uint16_t Port() const { return m_port; }
+    size_t Connections() const { return m_connections.load(); } // accepted so far
+    uint64_t Requests() const { return m_requests.load(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Outgoing {
+        Clock::time_point at;
+        std::string bytes; // empty: cut the connection
+    };
+
+    static bool SendAll(SOCKET s, const std::string& bytes) {
+        size_t sent = 0;
+        while (sent < bytes.size()) {
+            IoBuf buf;
+            Net::SetIoBuf(buf, const_cast<char*>(bytes.data()) + sent, bytes.size() - sent);
+            long long n = Net::SendV(s, &buf, 1);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Header value in `head`, matched case-sensitively as the clients here send them
+    static std::string Header(const std::string& head, std::string_view name) {
+        size_t p = head.find(std::string("\r\n").append(name).append(": "));
+        if (p == std::string::npos) return {};
+        p += name.size() + 4;
+        return head.substr(p, head.find("\r\n", p) - p);
+    }
+
+    void Serve(SOCKET s) {
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+        std::this_thread::sleep_for(m_rtt * m_handshakeRoundTrips);
+
+        // Responses leave in request order, each no earlier than its due time
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Outgoing> queue;
+        bool done = false;
+        std::thread writer([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                cv.wait(lock, [&] { return done || !queue.empty(); });
+                if (queue.empty()) return;
+                Outgoing next = std::move(queue.front());
+                queue.pop_front();
+                lock.unlock();
+                std::this_thread::sleep_until(next.at);
+                if (next.bytes.empty() || !SendAll(s, next.bytes)) shutdown(s, SD_BOTH);
+                lock.lock();
+            }
+        });
+        auto post = [&](Outgoing out) {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(out));
+            cv.notify_one();
+        };
+
+        std::string buffer;
+        char chunk[16384];
+        auto fill = [&] {
+            int n = recv(s, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buffer.append(chunk, n);
+            return true;
+        };
+        for (;;) {
+            size_t end;
+            bool open = true;
+            while (open && (end = buffer.find("\r\n\r\n")) == std::string::npos) open = fill();
+            if (!open) break;
+            std::string head = buffer.substr(0, end + 2);
+            size_t length = std::strtoull(Header(head, "Content-Length").c_str(), nullptr, 10);
+            buffer.erase(0, end + 4);
+            while (open && buffer.size() < length) open = fill();
+            if (!open) break;
+            const Clock::time_point arrived = Clock::now();
+            m_requests++;
+
+            MockRequest request;
+            size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+            request.method = head.substr(0, sp1);
+            request.target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+            request.body = buffer.substr(0, length);
+            buffer.erase(0, length);
+            std::string auth = Header(head, "Authorization");
+            if (auth.compare(0, 7, "Bearer ") == 0) request.bearerToken = auth.substr(7);
+            const bool close = Header(head, "Connection") == "close";
+
+            MockResponse response = m_handler ? m_handler(request) : MockResponse{ 404, "{}" };
+            // A response the handler held on to still spends half a round-trip on the way back
+            const Clock::time_point due = std::max(arrived + m_rtt + response.work, Clock::now() + m_rtt / 2);
+            if (response.status == 0) {
+                post({ due, {} });
+                break;
+            }
+            post({ due, "HTTP/1.1 " + std::to_string(response.status) + " Mock\r\nContent-Type: application/json\r\n" +
+                        "Content-Length: " + std::to_string(response.body.size()) + "\r\n" +
+                        (close ? "Connection: close\r\n\r\n" : "\r\n") + response.body });
+            if (close) {
+                post({ due, {} });
+                break;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        cv.notify_one();
+        writer.join();
+
+        // Closed here so that a run opening a connection per request does not pile up descriptors
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sockets.erase(std::find(m_sockets.begin(), m_sockets.end(), s));
+        closesocket(s);
+    }
+
+    Handler m_handler;
+    std::chrono::milliseconds m_rtt{ 0 };
+    int m_handshakeRoundTrips = 0;
+
+    SOCKET m_listen = INVALID_SOCKET;
+    uint16_t m_port = 0;
+    std::atomic<size_t> m_connections{ 0 };
+    std::atomic<uint64_t> m_requests{ 0 };
+    std::thread m_acceptThread;
+    std::mutex m_mutex;
+    std::vector<SOCKET> m_sockets;   // open connections
+    std::vector<std::thread> m_workers;
+};
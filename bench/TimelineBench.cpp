@@ -0,0 +1,248 @@
+// Timeline benchmarks. Prints one JSON document for the benchmark chosen with --bench:
+//
+//   rooms  multi-room routing and room switching: per-event cost of routing sync events into
+//          RoomTimelines, its FlatStringMap room lookup against std::unordered_map<std::string>,
+//          and the time to switch rooms by replaying the cached backlog against the old way,
+//          starting over with an initial /sync of the room from the mock homeserver
+//   log    local timeline store: appends --events messages to one room's TimelineLog through
+//          TimelineStore, then times reopening it (map and index), reading the newest 64
+//          events, and indexing the whole log back to its first record; files are written
+//          under --dir and removed afterwards
+//
+//   TimelineBench [--bench rooms|log] [--duration-ms 1000] [--rooms 1000] [--capacity 64] [--rtt-ms 20]
+//                 [--events 1000000] [--dir path] [--out results.json]
+#include "MockHomeserver.h"
+#include "RoomTimelines.h"
+#include "SocketHttpTransport.h"
+#include "SyncParser.h"
+#include "TimelineLog.h"
+#include "TimelineStore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static volatile uint64_t g_sink; // keeps the measured results alive
+
+// Average nanoseconds per call of `body(i)` over at least `duration`
+template <typename F>
+static double NanosPerCall(std::chrono::milliseconds duration, F&& body) {
+    uint64_t calls = 0;
+    auto start = Clock::now();
+    do {
+        for (int i = 0; i < 1024; ++i) body(calls + i);
+        calls += 1024;
+    } while (Clock::now() - start < duration);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+}
+
+// ----------------- Room routing and switching -----------------
+static std::string RoomId(size_t i) { return "!" + std::to_string(i * 7919) + "abcdefghijklmn:matrix.org"; }
+
+static std::string MessageEvent(size_t room, size_t i) {
+    return "{\"type\":\"m.room.message\",\"sender\":\"@peer:matrix.org\",\"event_id\":\"$r" + std::to_string(room) + "e" +
+           std::to_string(i) + "\",\"origin_server_ts\":" + std::to_string(1700000000000ull + i) +
+           ",\"content\":{\"msgtype\":\"m.text\",\"body\":\"a chat message body\"}}";
+}
+
+static void RunRooms(std::FILE* out, size_t rooms, size_t capacity, long rttMs, std::chrono::milliseconds duration) {
+    std::vector<std::string> ids;
+    for (size_t i = 0; i < rooms; ++i) ids.push_back(RoomId(i));
+    // Room IDs as SyncParser hands them out, in a random order
+    std::vector<std::string_view> probes;
+    std::mt19937 rng(1);
+    for (int i = 0; i < 1 << 16; ++i) probes.push_back(ids[rng() % rooms]);
+    const size_t mask = probes.size() - 1;
+
+    uint64_t sink = 0;
+    FlatStringMap<size_t> flat;
+    std::unordered_map<std::string, size_t> map;
+    for (size_t i = 0; i < rooms; ++i) {
+        flat.Emplace(ids[i], i);
+        map[ids[i]] = i;
+    }
+    double flatNs = NanosPerCall(duration, [&](uint64_t i) { sink += *flat.Find(probes[i & mask]); });
+    double mapNs = NanosPerCall(duration, [&](uint64_t i) { sink += map.find(std::string(probes[i & mask]))->second; });
+
+    RoomTimelines timelines(capacity);
+    const RoomMessage message{ "$event", "@peer:matrix.org", "a chat message body", 1700000000000ull };
+    double appendNs = NanosPerCall(duration, [&](uint64_t i) { sink += timelines.Append(probes[i & mask], message); });
+
+    uint64_t replayed = 0;
+    double switchNs = NanosPerCall(duration, [&](uint64_t i) {
+        timelines.SetActive(ids[i % rooms], [&replayed](const RoomMessage& m) { replayed += m.body.size(); });
+    });
+    g_sink = sink + replayed;
+
+    // Before: nothing cached, so the client started over with an initial sync for the new room
+    MockHomeserver server;
+    server.SetRoundTrip(std::chrono::milliseconds(rttMs));
+    server.SetHandler([capacity](const MockRequest& request) {
+        size_t room = std::strtoull(request.Query("room").c_str(), nullptr, 10);
+        std::string body = "{\"next_batch\":\"s1\",\"rooms\":{\"join\":{\"" + RoomId(room) + "\":{\"timeline\":{\"events\":[";
+        for (size_t i = 0; i < capacity; ++i) body += (i ? "," : "") + MessageEvent(room, i);
+        return MockResponse{ 200, body + "]}}}}}" };
+    });
+    if (!server.Start()) {
+        std::fprintf(stderr, "cannot start mock homeserver\n");
+        std::exit(1);
+    }
+    SocketHttpTransport http("127.0.0.1", server.Port());
+    std::vector<double> resyncMs;
+    auto start = Clock::now();
+    for (size_t i = 0; Clock::now() - start < duration || resyncMs.size() < 3; ++i) {
+        auto t0 = Clock::now();
+        const std::string& roomId = ids[i % rooms];
+        HttpResponse r = http.Request("GET", "/_matrix/client/r0/sync?timeout=0&room=" + std::to_string(i % rooms), "", "tok");
+        SyncBatch batch;
+        if (r.status != 200 || !ParseSync(r.body, [&roomId](std::string_view room) { return room == roomId; }, batch) ||
+            batch.events.size() != capacity) {
+            std::fprintf(stderr, "resync failed with status %d\n", r.status);
+            std::exit(1);
+        }
+        resyncMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+    }
+    server.Stop();
+    std::sort(resyncMs.begin(), resyncMs.end());
+
+    std::fprintf(out,
+        "{\n  \"benchmark\": \"room_switch\",\n  \"rooms\": %zu,\n  \"capacity\": %zu,\n  \"rtt_ms\": %ld,\n"
+        "  \"lookup_ns\": {\"flat_string_map\": %.1f, \"unordered_map\": %.1f},\n"
+        "  \"append_ns\": %.1f,\n"
+        "  \"switch\": {\"cached_us\": %.2f, \"initial_sync_ms_p50\": %.2f}\n}\n",
+        rooms, capacity, rttMs, flatNs, mapNs, appendNs, switchNs / 1000, resyncMs[resyncMs.size() / 2]);
+}
+
+// ----------------- Local timeline log -----------------
+static double MillisSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::string LogEventId(size_t i) {
+    char id[48];
+    std::snprintf(id, sizeof(id), "$%020zu_abcdefghijklmnopq", i);
+    return id;
+}
+
+static void RunLog(std::FILE* out, size_t events, const std::filesystem::path& dir) {
+    namespace fs = std::filesystem;
+    const std::string roomId = RoomId(1);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+
+    // Message bodies of 20-119 bytes, regenerated from the same seed to check what comes back
+    auto bodyOf = [](std::mt19937_64& rng, size_t i) { return std::string(20 + rng() % 100, char('a' + i % 26)); };
+
+    double appendMs, closeMs;
+    {
+        TimelineStore store(std::chrono::milliseconds(5));
+        if (!store.Open(dir)) {
+            std::fprintf(stderr, "cannot open a timeline store in %s\n", dir.string().c_str());
+            std::exit(1);
+        }
+        std::mt19937_64 rng(1);
+        auto start = Clock::now();
+        for (size_t i = 0; i < events; ++i)
+            store.Append(roomId, LogEventId(i), "@peer:matrix.org", bodyOf(rng, i), 1700000000000ull + i);
+        appendMs = MillisSince(start);
+        start = Clock::now();
+        store.Close();
+        closeMs = MillisSince(start);
+    }
+    const fs::path file = dir / (TimelineStore::FileName(roomId) + ".tlog");
+    const double fileMb = fs::file_size(file) / 1e6;
+
+    // Reopened with the file in the page cache, as on a relaunch
+    std::vector<double> openMs, recentMs;
+    size_t indexed = 0, recent = 0;
+    for (int run = 0; run < 5; ++run) {
+        TimelineStore store;
+        auto start = Clock::now();
+        store.Open(dir);
+        openMs.push_back(MillisSince(start));
+        indexed = store.EventCount(roomId);
+        start = Clock::now();
+        recent = 0;
+        store.ForEachRecent(roomId, 64, [&recent](const TimelineRecord&) { ++recent; });
+        recentMs.push_back(MillisSince(start));
+    }
+    std::sort(openMs.begin(), openMs.end());
+    std::sort(recentMs.begin(), recentMs.end());
+
+    // Scrolling back to the very first message indexes every record
+    TimelineLog log;
+    log.Open(file, roomId);
+    auto start = Clock::now();
+    log.Get(0);
+    const double fullIndexMs = MillisSince(start);
+
+    std::mt19937_64 rng(1);
+    bool correct = indexed == events && recent == std::min<size_t>(events, 64) && log.IndexedCount() == events;
+    for (size_t i = 0; correct && i < events; ++i) {
+        std::string body = bodyOf(rng, i);
+        TimelineRecord r = log.Get(i);
+        correct = r.eventId == LogEventId(i) && r.body == body && r.originServerTs == 1700000000000ull + i;
+    }
+    log.Close();
+    fs::remove_all(dir, ec);
+
+    std::fprintf(out,
+        "{\n  \"benchmark\": \"timeline_log\",\n  \"events\": %zu,\n  \"file_mb\": %.1f,\n"
+        "  \"append_ns_per_event\": %.1f,\n  \"close_ms\": %.2f,\n"
+        "  \"open_index_ms_p50\": %.3f,\n  \"recent_64_ms_p50\": %.3f,\n  \"full_index_ms\": %.2f,\n"
+        "  \"correct\": %s\n}\n",
+        events, fileMb, appendMs * 1e6 / std::max<size_t>(events, 1), closeMs, openMs[openMs.size() / 2],
+        recentMs[recentMs.size() / 2], fullIndexMs, correct ? "true" : "false");
+}
+
+// ----------------- Command line -----------------
+int main(int argc, char** argv) {
+    std::string bench = "rooms";
+    long durationMs = 1000;
+    size_t rooms = 1000;
+    size_t capacity = 64;
+    long rttMs = 20;
+    size_t events = 1000000;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "TalksterTimelineBench";
+    const char* outPath = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--bench") bench = argv[i + 1];
+        else if (arg == "--duration-ms") durationMs = std::strtol(argv[i + 1], nullptr, 10);
+        else if (arg == "--rooms") rooms = std::max(1L, std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--capacity") capacity = std::max(1L, std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--rtt-ms") rttMs = std::strtol(argv[i + 1], nullptr, 10);
+        else if (arg == "--events") events = std::max(1L, std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--dir") dir = argv[i + 1];
+        else if (arg == "--out") outPath = argv[i + 1];
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (bench != "rooms" && bench != "log") {
+        std::fprintf(stderr, "unknown benchmark %s\n", bench.c_str());
+        return 2;
+    }
+    const std::chrono::milliseconds duration(durationMs);
+
+    std::FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", outPath);
+        return 1;
+    }
+
+    if (bench == "rooms") RunRooms(out, rooms, capacity, rttMs, duration);
+    else RunLog(out, events, dir);
+
+    if (outPath) std::fclose(out);
+    return 0;
+}
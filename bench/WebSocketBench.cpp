@@ -0,0 +1,423 @@
+// WebSocket benchmarks. Prints one JSON document for the benchmark chosen with --bench:
+//
+//   loopback  an in-process echo server and N WebSocketClient connections, each keeping a window
+//             of messages in flight: messages/sec, MB/sec and round-trip percentiles for every
+//             (mode, payload size, connections) case
+//   mask      payload masking: ApplyWebSocketMask against the per-byte push_back loop it replaced
+//   keys      small-message framing rate with masking keys from std::random_device (four calls per
+//             frame, as before) and from the per-connection ChaCha20Rng
+//   deflate   chat-like JSON messages echoed with permessage-deflate off and on: messages/sec,
+//             client-to-server bytes on the wire per message and process CPU time per message
+//
+//   WebSocketBench [--bench loopback] [--duration-ms 1000] [--window 16] [--sizes 16,256,4096,65536]
+//                  [--connections 1,8,64] [--modes threaded,reactor] [--out results.json]
+#include "ChaCha20Rng.h"
+#include "EchoServer.h"
+#include "WebSocketClient.h"
+#include "WebSocketMask.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// ----------------- Load generator -----------------
+struct Case {
+    bool reactor;
+    size_t payload;
+    int connections;
+};
+
+struct Result {
+    Case c;
+    uint64_t messages = 0;
+    double seconds = 0;
+    std::vector<uint32_t> rttUs;
+};
+
+// Payload: the send time as 16 hex digits, padded to the requested size
+static void StampPayload(std::string& payload) {
+    uint64_t now = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < 16; ++i) payload[i] = hex[(now >> (60 - 4 * i)) & 0xF];
+}
+
+static uint64_t ReadStamp(std::string_view payload) {
+    uint64_t v = 0;
+    for (int i = 0; i < 16 && i < (int)payload.size(); ++i) {
+        char c = payload[i];
+        v = (v << 4) | static_cast<uint64_t>(c <= '9' ? c - '0' : c - 'a' + 10);
+    }
+    return v;
+}
+
+struct Connection {
+    std::unique_ptr<WebSocketClient> client;
+    std::string payload;
+    std::vector<uint32_t> rttUs; // touched only by the client's receive (or reactor) thread
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<bool> measuring{ false };
+    std::atomic<bool> stopping{ false };
+};
+
+static Result RunCase(const Case& c, uint16_t port, int window, std::chrono::milliseconds duration) {
+    std::unique_ptr<WebSocketReactor> reactor;
+    if (c.reactor) reactor = std::make_unique<WebSocketReactor>();
+
+    std::vector<std::unique_ptr<Connection>> conns;
+    for (int i = 0; i < c.connections; ++i) {
+        auto conn = std::make_unique<Connection>();
+        conn->payload.assign(std::max<size_t>(c.payload, 16), 'x');
+        conn->client = std::make_unique<WebSocketClient>("127.0.0.1", port);
+        conn->client->SetKeepalive(std::chrono::milliseconds(0));
+        if (reactor) conn->client->SetReactor(reactor.get());
+
+        Connection* self = conn.get();
+        self->rttUs.reserve(1 << 16);
+        self->client->SetOnMessageView([self](std::string_view echoed) {
+            if (self->measuring) {
+                auto sent = Clock::time_point(Clock::duration(ReadStamp(echoed)));
+                auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - sent);
+                self->rttUs.push_back(static_cast<uint32_t>(rtt.count()));
+                self->received++;
+            }
+            if (self->stopping) return;
+            StampPayload(self->payload); // keep the window full
+            self->client->Send(std::string_view(self->payload));
+        });
+        if (!conn->client->Connect()) {
+            std::fprintf(stderr, "connect failed\n");
+            std::exit(1);
+        }
+        conns.push_back(std::move(conn));
+    }
+
+    for (auto& conn : conns) {
+        for (int i = 0; i < window; ++i) {
+            StampPayload(conn->payload);
+            conn->client->Send(std::string_view(conn->payload));
+        }
+    }
+
+    std::this_thread::sleep_for(duration / 5); // warm-up
+    for (auto& conn : conns) conn->measuring = true;
+    auto start = Clock::now();
+    std::this_thread::sleep_for(duration);
+    for (auto& conn : conns) conn->measuring = false;
+    auto elapsed = Clock::now() - start;
+    for (auto& conn : conns) conn->stopping = true;
+
+    Result result;
+    result.c = c;
+    result.seconds = std::chrono::duration<double>(elapsed).count();
+    for (auto& conn : conns) {
+        conn->client->Close();
+        result.messages += conn->received;
+        result.rttUs.insert(result.rttUs.end(), conn->rttUs.begin(), conn->rttUs.end());
+    }
+    return result;
+}
+
+static double Percentile(std::vector<uint32_t>& v, double p) {
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static void RunLoopback(std::FILE* out, uint16_t port, const std::vector<bool>& modes, const std::vector<long>& connections,
+                        const std::vector<long>& sizes, int window, std::chrono::milliseconds duration) {
+    std::fprintf(out, "{\n  \"benchmark\": \"websocket_loopback\",\n  \"duration_ms\": %lld,\n  \"window\": %d,\n  \"results\": [",
+                 (long long)duration.count(), window);
+    bool first = true;
+    for (bool reactor : modes) {
+        for (long conns : connections) {
+            for (long size : sizes) {
+                Case c{ reactor, static_cast<size_t>(size), static_cast<int>(conns) };
+                Result r = RunCase(c, port, window, duration);
+                const double mps = r.messages / r.seconds;
+                std::fprintf(out,
+                    "%s\n    {\"mode\": \"%s\", \"payload_bytes\": %zu, \"connections\": %d, \"messages\": %llu, "
+                    "\"msgs_per_sec\": %.0f, \"mb_per_sec\": %.2f, "
+                    "\"rtt_us\": {\"p50\": %.0f, \"p99\": %.0f, \"p999\": %.0f}}",
+                    first ? "" : ",", reactor ? "reactor" : "threaded", c.payload, c.connections,
+                    (unsigned long long)r.messages, mps, mps * c.payload / (1024.0 * 1024.0),
+                    Percentile(r.rttUs, 0.50), Percentile(r.rttUs, 0.99), Percentile(r.rttUs, 0.999));
+                std::fflush(out);
+                first = false;
+            }
+        }
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+// ----------------- Masking kernel -----------------
+static volatile uint64_t g_sink; // keeps the measured results alive
+
+// Calls `body` in rounds of 64 until `duration` has passed; returns calls per second
+template <typename F>
+static double CallsPerSecond(std::chrono::milliseconds duration, F&& body) {
+    uint64_t calls = 0;
+    auto start = Clock::now();
+    do {
+        for (int i = 0; i < 64; ++i) body();
+        calls += 64;
+    } while (Clock::now() - start < duration);
+    return calls / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void RunMask(std::FILE* out, const std::vector<long>& sizes, std::chrono::milliseconds duration) {
+    const uint8_t key[4] = { 0x12, 0x34, 0x56, 0x78 };
+    uint64_t sink = 0;
+    std::fprintf(out, "{\n  \"benchmark\": \"mask\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+                 (long long)duration.count());
+    bool first = true;
+    for (long size : sizes) {
+        const size_t n = static_cast<size_t>(std::max(1L, size));
+        std::vector<uint8_t> src(n, 'a');
+        std::vector<uint8_t> buf(src);
+
+        // What Send() did before the kernel: a fresh vector, a modulo and a push_back per byte
+        double loop = CallsPerSecond(duration, [&] {
+            std::vector<uint8_t> frame;
+            for (size_t i = 0; i < n; ++i) frame.push_back(src[i] ^ key[i % 4]);
+            sink += frame[n / 2];
+        });
+        double kernel = CallsPerSecond(duration, [&] {
+            ApplyWebSocketMask(buf.data(), n, key);
+            sink += buf[n / 2];
+        });
+        std::fprintf(out,
+            "%s\n    {\"payload_bytes\": %zu, \"byte_loop_gb_per_sec\": %.3f, \"kernel_gb_per_sec\": %.3f, \"speedup\": %.1f}",
+            first ? "" : ",", n, loop * n / 1e9, kernel * n / 1e9, kernel / loop);
+        std::fflush(out);
+        first = false;
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    g_sink = sink;
+}
+
+// ----------------- Masking keys -----------------
+// Frames a payload the way Send() does, into a reused buffer: header, masking key, masked payload.
+// Only the key source differs between the runs.
+template <typename KeySource>
+static void BuildFrame(std::vector<uint8_t>& frame, const std::string& payload, KeySource&& nextKey) {
+    uint8_t header[6] = { 0x81, static_cast<uint8_t>(0x80 | payload.size()) };
+    nextKey(header + 2);
+    frame.resize(6 + payload.size());
+    std::memcpy(frame.data(), header, 6);
+    std::memcpy(frame.data() + 6, payload.data(), payload.size());
+    ApplyWebSocketMask(frame.data() + 6, payload.size(), header + 2);
+}
+
+static void RunKeys(std::FILE* out, const std::vector<long>& sizes, std::chrono::milliseconds duration) {
+    uint64_t sink = 0;
+    std::fprintf(out, "{\n  \"benchmark\": \"masking_keys\",\n  \"duration_ms\": %lld,\n  \"results\": [",
+                 (long long)duration.count());
+    bool first = true;
+    for (long size : sizes) {
+        const std::string payload(static_cast<size_t>(std::clamp(size, 1L, 125L)), 'x'); // one-byte length
+        std::vector<uint8_t> frame;
+
+        // Before: a std::random_device per frame, called once per key byte
+        double before = CallsPerSecond(duration, [&] {
+            BuildFrame(frame, payload, [](uint8_t* key) {
+                std::random_device rd;
+                for (int i = 0; i < 4; ++i) key[i] = static_cast<uint8_t>(rd());
+            });
+            sink += frame[2];
+        });
+        // After: the connection's ChaCha20Rng behind its mutex, as BeginFrame() uses it
+        ChaCha20Rng rng;
+        std::mutex rngMutex;
+        double after = CallsPerSecond(duration, [&] {
+            BuildFrame(frame, payload, [&](uint8_t* key) {
+                std::lock_guard<std::mutex> lock(rngMutex);
+                rng.NextMaskKey(key);
+            });
+            sink += frame[2];
+        });
+        std::fprintf(out,
+            "%s\n    {\"payload_bytes\": %zu, \"random_device_msgs_per_sec\": %.0f, \"chacha20_msgs_per_sec\": %.0f, \"speedup\": %.1f}",
+            first ? "" : ",", payload.size(), before, after, after / before);
+        std::fflush(out);
+        first = false;
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    g_sink = sink;
+}
+
+// ----------------- permessage-deflate -----------------
+// Overlay chat traffic: short, repetitive m.text bodies in the same JSON envelope
+static std::vector<std::string> ChatMessages(size_t count) {
+    static const char* const words[] = { "gg", "lol", "anyone up for ranked?", "push mid", "nice shot", "brb",
+                                         "@alice ready", "defending B site", "one more?", "wp" };
+    std::mt19937 rng(7);
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < count; ++i) {
+        messages.push_back(std::string("{\"msgtype\":\"m.text\",\"body\":\"") + words[rng() % 10] + " " +
+                           words[rng() % 10] + "\"}");
+    }
+    return messages;
+}
+
+struct DeflateResult {
+    uint64_t messages = 0;
+    double seconds = 0;
+    double cpuSeconds = 0;   // whole process: client and echo server
+    uint64_t payloadBytes = 0;
+    uint64_t wireBytes = 0;  // client to server, frame headers included
+};
+
+static DeflateResult RunDeflateCase(EchoServer& server, bool deflate, int window, std::chrono::milliseconds duration) {
+    static const std::vector<std::string> chat = ChatMessages(1024);
+
+    WebSocketClient client("127.0.0.1", server.Port());
+    client.SetKeepalive(std::chrono::milliseconds(0));
+    if (deflate) client.EnableDeflate();
+
+    std::atomic<uint64_t> echoed{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<bool> stopping{ false };
+    size_t next = static_cast<size_t>(window); // receive thread only; the first `window` go out below
+    client.SetOnMessageView([&](std::string_view) {
+        echoed++;
+        if (stopping) return;
+        const std::string& message = chat[next++ % chat.size()];
+        bytes += message.size();
+        client.Send(std::string_view(message));
+    });
+    if (!client.Connect()) {
+        std::fprintf(stderr, "connect failed\n");
+        std::exit(1);
+    }
+
+    DeflateResult result;
+    for (int i = 0; i < window; ++i) client.Send(std::string_view(chat[i % chat.size()]));
+
+    std::this_thread::sleep_for(duration / 5); // warm-up
+    uint64_t echoed0 = echoed, bytes0 = bytes, wire0 = server.BytesReceived();
+    std::clock_t cpu0 = std::clock();
+    auto start = Clock::now();
+    std::this_thread::sleep_for(duration);
+    result.messages = echoed - echoed0;
+    result.payloadBytes = bytes - bytes0;
+    result.wireBytes = server.BytesReceived() - wire0;
+    result.cpuSeconds = static_cast<double>(std::clock() - cpu0) / CLOCKS_PER_SEC;
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    stopping = true;
+    client.Close();
+    return result;
+}
+
+static void RunDeflate(std::FILE* out, int window, std::chrono::milliseconds duration) {
+    EchoServer server;
+    server.SetDeflate(true);
+    if (!server.Start()) {
+        std::fprintf(stderr, "cannot start echo server\n");
+        std::exit(1);
+    }
+    std::fprintf(out, "{\n  \"benchmark\": \"deflate\",\n  \"duration_ms\": %lld,\n  \"window\": %d,\n  \"zlib\": %s,\n  \"results\": [",
+                 (long long)duration.count(), window, WebSocketDeflate::Available() ? "true" : "false");
+    bool first = true;
+    for (bool deflate : { false, true }) {
+        DeflateResult r = RunDeflateCase(server, deflate, window, duration);
+        const double n = static_cast<double>(std::max<uint64_t>(r.messages, 1));
+        std::fprintf(out,
+            "%s\n    {\"deflate\": %s, \"messages\": %llu, \"msgs_per_sec\": %.0f, "
+            "\"payload_bytes_per_msg\": %.1f, \"wire_bytes_per_msg\": %.1f, \"cpu_us_per_msg\": %.2f}",
+            first ? "" : ",", deflate ? "true" : "false",
+            (unsigned long long)r.messages, r.messages / r.seconds, r.payloadBytes / n, r.wireBytes / n,
+            r.cpuSeconds * 1e6 / n);
+        std::fflush(out);
+        first = false;
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    server.Stop();
+}
+
+// ----------------- Command line -----------------
+static std::vector<long> ParseList(const char* s) {
+    std::vector<long> out;
+    for (const char* p = s; *p;) {
+        char* end;
+        out.push_back(std::strtol(p, &end, 10));
+        p = *end == ',' ? end + 1 : end;
+        if (end == p && *p) break;
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    std::string bench = "loopback";
+    long durationMs = 1000;
+    int window = 16;
+    std::vector<long> sizes;
+    std::vector<long> connections = { 1, 8, 64 };
+    std::vector<bool> modes = { false, true };
+    const char* outPath = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--bench") bench = argv[i + 1];
+        else if (arg == "--duration-ms") durationMs = std::strtol(argv[i + 1], nullptr, 10);
+        else if (arg == "--window") window = std::max(1, (int)std::strtol(argv[i + 1], nullptr, 10));
+        else if (arg == "--sizes") sizes = ParseList(argv[i + 1]);
+        else if (arg == "--connections") connections = ParseList(argv[i + 1]);
+        else if (arg == "--modes") {
+            std::string m = argv[i + 1];
+            modes.clear();
+            if (m.find("threaded") != std::string::npos) modes.push_back(false);
+            if (m.find("reactor") != std::string::npos) modes.push_back(true);
+        } else if (arg == "--out") outPath = argv[i + 1];
+        else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (bench != "loopback" && bench != "mask" && bench != "keys" && bench != "deflate") {
+        std::fprintf(stderr, "unknown benchmark %s\n", bench.c_str());
+        return 2;
+    }
+    if (sizes.empty()) {
+        if (bench == "mask") sizes = { 16, 1024, 1048576 };
+        else if (bench == "keys") sizes = { 16, 64, 125 };
+        else sizes = { 16, 256, 4096, 65536 };
+    }
+    const std::chrono::milliseconds duration(durationMs);
+
+    // The client logs to stderr, so stdout (or --out) carries only the JSON
+    std::FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", outPath);
+        return 1;
+    }
+
+    if (bench == "mask") {
+        RunMask(out, sizes, duration);
+    } else if (bench == "keys") {
+        RunKeys(out, sizes, duration);
+    } else if (bench == "deflate") {
+        RunDeflate(out, window, duration);
+    } else {
+        EchoServer server;
+        if (!server.Start()) {
+            std::fprintf(stderr, "cannot start echo server\n");
+            return 1;
+        }
+        RunLoopback(out, server.Port(), modes, connections, sizes, window, duration);
+        server.Stop();
+    }
+
+    if (outPath) std::fclose(out);
+    return 0;
+}
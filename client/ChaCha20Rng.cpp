@@ -0,0 +1,113 @@
+#include "ChaCha20Rng.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <random>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#elif defined(__linux__)
+#include <sys/random.h>
+#endif
+
+static inline uint32_t Rotl(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+#define QUARTERROUND(a, b, c, d)               \
+    a += b; d ^= a; d = Rotl(d, 16);           \
+    c += d; b ^= c; b = Rotl(b, 12);           \
+    a += b; d ^= a; d = Rotl(d, 8);            \
+    c += d; b ^= c; b = Rotl(b, 7);
+
+static void ChaChaBlock(const uint32_t in[16], uint8_t out[64]) {
+    uint32_t x[16];
+    std::memcpy(x, in, sizeof(x));
+    for (int i = 0; i < 10; ++i) {
+        QUARTERROUND(x[0], x[4], x[8],  x[12]);
+        QUARTERROUND(x[1], x[5], x[9],  x[13]);
+        QUARTERROUND(x[2], x[6], x[10], x[14]);
+        QUARTERROUND(x[3], x[7], x[11], x[15]);
+        QUARTERROUND(x[0], x[5], x[10], x[15]);
+        QUARTERROUND(x[1], x[6], x[11], x[12]);
+        QUARTERROUND(x[2], x[7], x[8],  x[13]);
+        QUARTERROUND(x[3], x[4], x[9],  x[14]);
+    }
+    for (int i = 0; i < 16; ++i) {
+        uint32_t v = x[i] + in[i];
+        out[i * 4 + 0] = static_cast<uint8_t>(v);
+        out[i * 4 + 1] = static_cast<uint8_t>(v >> 8);
+        out[i * 4 + 2] = static_cast<uint8_t>(v >> 16);
+        out[i * 4 + 3] = static_cast<uint8_t>(v >> 24);
+    }
+}
+
+#undef QUARTERROUND
+
+bool ChaCha20Rng::OsRandom(void* out, size_t len) {
+#ifdef _WIN32
+    return BCRYPT_SUCCESS(BCryptGenRandom(nullptr, static_cast<PUCHAR>(out), static_cast<ULONG>(len),
+                                          BCRYPT_USE_SYSTEM_PREFERRED_RNG));
+#elif defined(__linux__)
+    auto* p = static_cast<uint8_t*>(out);
+    while (len > 0) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+#else
+    std::random_device rd;
+    auto* p = static_cast<uint8_t*>(out);
+    for (size_t i = 0; i < len; ++i) p[i] = static_cast<uint8_t>(rd());
+    return true;
+#endif
+}
+
+ChaCha20Rng::ChaCha20Rng() {
+    Seed();
+}
+
+void ChaCha20Rng::Seed() {
+    // "expand 32-byte k", then a 256-bit key, a block counter and a 96-bit nonce
+    m_state[0] = 0x61707865; m_state[1] = 0x3320646e; m_state[2] = 0x79622d32; m_state[3] = 0x6b206574;
+    uint32_t seed[11];
+    if (!OsRandom(seed, sizeof(seed))) {
+        std::random_device rd;
+        for (auto& w : seed) w = rd();
+    }
+    std::memcpy(&m_state[4], seed, 8 * sizeof(uint32_t));
+    m_state[12] = 0;
+    std::memcpy(&m_state[13], seed + 8, 3 * sizeof(uint32_t));
+    m_blocks = 0;
+}
+
+void ChaCha20Rng::Refill() {
+    if (m_blocks >= kReseedBlocks) Seed();
+    for (size_t i = 0; i < kBlocks; ++i) {
+        ChaChaBlock(m_state, m_buffer + i * 64);
+        m_state[12]++;
+    }
+    m_blocks += kBlocks;
+    m_used = 0;
+}
+
+void ChaCha20Rng::Fill(void* out, size_t len) {
+    auto* dst = static_cast<uint8_t*>(out);
+    while (len > 0) {
+        if (m_used == sizeof(m_buffer)) Refill();
+        size_t n = std::min(len, sizeof(m_buffer) - m_used);
+        std::memcpy(dst, m_buffer + m_used, n);
+        std::memset(m_buffer + m_used, 0, n); // handed-out bytes do not linger in memory
+        m_used += n;
+        dst += n;
+        len -= n;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// ChaCha20 keystream used as a CSPRNG, seeded once from the OS (BCryptGenRandom / getrandom).
+// Output is generated a few blocks at a time so a 4-byte masking key is normally a plain copy.
+// Not thread-safe: each owner serializes its own calls.
+class ChaCha20Rng {
+public:
+    ChaCha20Rng();
+
+    ChaCha20Rng(const ChaCha20Rng&) = delete;
+    ChaCha20Rng& operator=(const ChaCha20Rng&) = delete;
+
+    void Fill(void* out, size_t len);
+    void NextMaskKey(uint8_t key[4]) { Fill(key, 4); }
+
+    // Fills `out` from the operating system's generator. Returns false if it is unavailable.
+    static bool OsRandom(void* out, size_t len);
+
+private:
+    static constexpr size_t kBlocks = 4;                // 256 bytes = 64 masking keys per refill
+    static constexpr uint64_t kReseedBlocks = 1ull << 20; // fresh OS key every 64 MB of output
+
+    void Seed();
+    void Refill();
+
+    uint32_t m_state[16];
+    uint8_t m_buffer[64 * kBlocks];
+    size_t m_used = sizeof(m_buffer);
+    uint64_t m_blocks = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash map from string keys to V. Entries live densely in insertion order; the
+// probe table holds only a 32-bit hash tag and an entry index per slot, so a lookup touches one
+// or two cache lines before comparing a single key. Lookups take string_view (no temporary
+// std::string). There is no erase; pointers returned by Find() are invalidated by an insert.
+template <typename V>
+class FlatStringMap {
+public:
+    struct Entry {
+        std::string key;
+        V value;
+    };
+
+    V* Find(std::string_view key) {
+        size_t slot = Probe(key, Hash(key));
+        return m_slots.empty() || m_slots[slot].index == kEmpty ? nullptr : &m_entries[m_slots[slot].index].value;
+    }
+
+    const V* Find(std::string_view key) const {
+        return const_cast<FlatStringMap*>(this)->Find(key);
+    }
+
+    // The value for `key`, constructed from `args` if the key is new
+    template <typename... Args>
+    V& Emplace(std::string_view key, Args&&... args) {
+        if (V* found = Find(key)) return *found;
+        if ((m_entries.size() + 1) * 4 > m_slots.size() * 3) Rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+
+        uint64_t hash = Hash(key);
+        size_t slot = Probe(key, hash);
+        m_slots[slot] = { static_cast<uint32_t>(hash), static_cast<uint32_t>(m_entries.size()) };
+        m_entries.push_back({ std::string(key), V(std::forward<Args>(args)...) });
+        return m_entries.back().value;
+    }
+
+    size_t Size() const { return m_entries.size(); }
+    const std::vector<Entry>& Entries() const { return m_entries; }
+
+private:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    struct Slot {
+        uint32_t tag = 0;
+        uint32_t index = kEmpty;
+    };
+
+    static uint64_t Hash(std::string_view key) { return std::hash<std::string_view>{}(key); }
+
+    // Slot holding `key`, or the empty slot where it would go
+    size_t Probe(std::string_view key, uint64_t hash) const {
+        if (m_slots.empty()) return 0;
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& s = m_slots[i];
+            if (s.index == kEmpty) return i;
+            if (s.tag == static_cast<uint32_t>(hash) && m_entries[s.index].key == key) return i;
+        }
+    }
+
+    void Rehash(size_t slots) {
+        m_slots.assign(slots, Slot{});
+        size_t mask = slots - 1;
+        for (uint32_t e = 0; e < m_entries.size(); ++e) {
+            uint64_t hash = Hash(m_entries[e].key);
+            size_t i = hash & mask;
+            while (m_slots[i].index != kEmpty) i = (i + 1) & mask;
+            m_slots[i] = { static_cast<uint32_t>(hash), e };
+        }
+    }
+
+    std::vector<Slot> m_slots; // power of two, at most 3/4 full
+    std::vector<Entry> m_entries;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct HttpResponse {
+    int status = 0;     // 0 when no response arrived (connect or I/O failure, timeout, CancelAll())
+    std::string body;
+};
+
+struct HttpRequestSpec {
+    std::string_view method;
+    std::string_view target;
+    std::string_view body;
+    std::string_view bearerToken;
+};
+
+struct HttpTransportStats {
+    uint64_t requests = 0;
+    uint64_t connectionsOpened = 0; // TCP (+TLS) handshakes; requests - connectionsOpened were reused
+};
+
+// Blocking HTTP/1.1 client bound to one server. Implementations keep one long-lived session and
+// reuse keep-alive connections across requests; Request() may be called from several threads.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() = default;
+
+    // `target` is the path plus query string. A non-empty `bearerToken` adds an Authorization header.
+    virtual HttpResponse Request(std::string_view method, std::string_view target,
+                                 std::string_view body, std::string_view bearerToken = {}) = 0;
+
+    // Sends `requests` in order and returns their responses in the same order. Transports that can
+    // pipeline write them back to back on one connection: the server still receives them in order,
+    // but none waits a round-trip for the previous response. Once a request gets no response
+    // (status 0), the ones after it were not sent or their fate is unknown, and they come back with
+    // status 0 as well. The default sends one after another and stops after the first response
+    // that is not a 2xx, so nothing is sent behind a failed request.
+    virtual std::vector<HttpResponse> RequestPipelined(const std::vector<HttpRequestSpec>& requests) {
+        std::vector<HttpResponse> responses;
+        responses.reserve(requests.size());
+        for (const auto& r : requests) {
+            responses.push_back(Request(r.method, r.target, r.body, r.bearerToken));
+            if (responses.back().status < 200 || responses.back().status >= 300) break;
+        }
+        responses.resize(requests.size());
+        return responses;
+    }
+
+    // Aborts the requests in flight, including ones blocked waiting for a response; they return
+    // status 0 promptly, not after their timeout. Requests started afterwards work normally.
+    virtual void CancelAll() = 0;
+
+    // Longest one request may take to complete; long polls need more than their server-side timeout.
+    // Call before the first request.
+    virtual void SetTimeout(std::chrono::milliseconds timeout) = 0;
+
+    virtual HttpTransportStats GetStats() const = 0;
+};
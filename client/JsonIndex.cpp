@@ -0,0 +1,331 @@
+#include "JsonIndex.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_INDEX_SSE2 1
+#endif
+
+// ----------------- Structural index -----------------
+namespace {
+
+struct BlockMasks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0; // { } [ ] : ,
+};
+
+// One bit per byte of a 64-byte block
+BlockMasks Classify(const char* block) {
+    BlockMasks m;
+#ifdef JSON_INDEX_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lower = _mm_set1_epi8(0x20); // '[' | 0x20 == '{', ']' | 0x20 == '}'
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        __m128i folded = _mm_or_si128(v, lower);
+        __m128i structural = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+                                          _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        auto shift = 16 * i;
+        m.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+        m.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+        m.structural |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(structural))) << shift;
+    }
+#else
+    for (int i = 0; i < 64; ++i) {
+        char c = block[i];
+        uint64_t bit = 1ull << i;
+        if (c == '"') m.quote |= bit;
+        else if (c == '\\') m.backslash |= bit;
+        else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') m.structural |= bit;
+    }
+#endif
+    return m;
+}
+
+// Bits of characters preceded by an odd run of backslashes. `carry` says whether the previous
+// block ended in the middle of such a run (its last backslash escapes our first byte).
+uint64_t FindEscaped(uint64_t backslash, uint64_t& carry) {
+    constexpr uint64_t even = 0x5555555555555555ull;
+    backslash &= ~carry;
+    uint64_t followsEscape = (backslash << 1) | carry;
+    uint64_t oddStarts = backslash & ~even & ~followsEscape;
+    uint64_t evenStartRuns = oddStarts + backslash;
+    carry = evenStartRuns < oddStarts ? 1 : 0;
+    uint64_t invert = evenStartRuns << 1;
+    return (even ^ invert) & followsEscape;
+}
+
+// Bit i = XOR of bits 0..i: set from an opening quote up to (not including) its closing quote
+uint64_t PrefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view Trim(std::string_view s) {
+    while (!s.empty() && IsSpace(s.front())) s.remove_prefix(1);
+    while (!s.empty() && IsSpace(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+} // namespace
+
+bool JsonIndex::Build(std::string_view json) {
+    m_json = json;
+    m_structurals.clear();
+    m_structurals.reserve(json.size() / 6 + 16);
+
+    uint64_t escapeCarry = 0;
+    uint64_t inStringCarry = 0; // all ones while a string continues into the next block
+    char tail[64];
+    for (size_t base = 0; base < json.size(); base += 64) {
+        const char* block = json.data() + base;
+        if (json.size() - base < 64) {
+            size_t n = json.size() - base;
+            std::memcpy(tail, block, n);
+            std::memset(tail + n, ' ', sizeof(tail) - n);
+            block = tail;
+        }
+
+        BlockMasks m = Classify(block);
+        uint64_t quotes = m.quote & ~FindEscaped(m.backslash, escapeCarry);
+        uint64_t inString = PrefixXor(quotes) ^ inStringCarry;
+        inStringCarry = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+        for (uint64_t bits = (m.structural & ~inString) | quotes; bits; bits &= bits - 1)
+            m_structurals.push_back(static_cast<uint32_t>(base + std::countr_zero(bits)));
+    }
+    if (inStringCarry) return false;
+
+    // Objects only; nothing but whitespace before the opening brace
+    if (m_structurals.empty() || json[m_structurals[0]] != '{') return false;
+    return Trim(json.substr(0, m_structurals[0])).empty();
+}
+
+// ----------------- Lookup -----------------
+class JsonIndex::Walker {
+public:
+    static constexpr size_t kMaxPaths = 16;
+    static constexpr size_t kNotOnPath = SIZE_MAX;
+
+    Walker(const JsonIndex& index, const std::string_view* paths, size_t count, std::string_view* out)
+        : m_json(index.m_json), m_s(index.m_structurals), m_paths(paths), m_count(count), m_out(out) {}
+
+    // Walks the object whose '{' is the current token. `consumed[j]` is how much of paths[j] the
+    // keys leading here matched, or kNotOnPath.
+    bool Object(unsigned depth, const size_t* consumed) {
+        ++m_i;
+        if (Tok(m_i) == '}') {
+            ++m_i;
+            return true;
+        }
+        for (;;) {
+            if (Tok(m_i) != '"' || Tok(m_i + 1) != '"' || Tok(m_i + 2) != ':') return false;
+            std::string_view key = m_json.substr(m_s[m_i] + 1, m_s[m_i + 1] - m_s[m_i] - 1);
+            m_i += 3;
+
+            size_t child[kMaxPaths];
+            bool descend = false;
+            size_t exact = kNotOnPath;
+            for (size_t j = 0; j < m_count; ++j) {
+                child[j] = kNotOnPath;
+                if (consumed[j] == kNotOnPath || m_out[j].data()) continue;
+                std::string_view rest = m_paths[j].substr(consumed[j]);
+                if (!rest.starts_with(key)) continue;
+                if (rest.size() == key.size()) {
+                    if (exact == kNotOnPath) exact = j;
+                } else if (rest[key.size()] == '.') {
+                    child[j] = consumed[j] + key.size() + 1;
+                    descend = true;
+                }
+            }
+
+            size_t start = m_i < m_s.size() ? m_s[m_i] : 0;
+            char t = Tok(m_i);
+            if (descend && t == '{' && depth < kMaxDepth) {
+                if (!Object(depth + 1, child)) return false;
+                if (m_found == m_count) return true;
+                if (exact != kNotOnPath) Record(exact, m_json.substr(start, m_s[m_i - 1] + 1 - start));
+            } else if (exact != kNotOnPath) {
+                std::string_view value;
+                if (!Value(value)) return false;
+                Record(exact, value);
+            } else if (!Skip()) {
+                return false;
+            }
+            if (m_found == m_count) return true;
+
+            t = Tok(m_i++);
+            if (t == '}') return true;
+            if (t != ',') return false;
+        }
+    }
+
+    size_t Found() const { return m_found; }
+
+private:
+    static constexpr unsigned kMaxDepth = 64;
+
+    char Tok(size_t k) const { return k < m_s.size() ? m_json[m_s[k]] : '\0'; }
+
+    void Record(size_t j, std::string_view value) {
+        // Any other path naming the same key (a duplicate in `paths`) gets it too
+        for (size_t k = j; k < m_count; ++k) {
+            if (k != j && m_paths[k] != m_paths[j]) continue;
+            if (m_out[k].data()) continue;
+            m_out[k] = value;
+            m_found++;
+        }
+    }
+
+    // The value at the current token: a scalar ends at the next token and consumes none
+    bool Value(std::string_view& value) {
+        char t = Tok(m_i);
+        if (t == '"') {
+            if (Tok(m_i + 1) != '"') return false;
+            value = m_json.substr(m_s[m_i] + 1, m_s[m_i + 1] - m_s[m_i] - 1);
+            m_i += 2;
+            return true;
+        }
+        if (t == '{' || t == '[') {
+            size_t start = m_i < m_s.size() ? m_s[m_i] : 0;
+            if (!Skip()) return false;
+            value = m_json.substr(start, m_s[m_i - 1] + 1 - start);
+            return true;
+        }
+        if (t != ',' && t != '}' && t != ']') return false;
+        size_t from = m_s[m_i - 1] + 1;
+        value = Trim(m_json.substr(from, m_s[m_i] - from));
+        return !value.empty();
+    }
+
+    bool Skip() {
+        char t = Tok(m_i);
+        if (t == '"') {
+            m_i += 2;
+            return Tok(m_i - 1) == '"';
+        }
+        if (t == '{' || t == '[') {
+            int depth = 0;
+            do {
+                t = Tok(m_i++);
+                if (t == '{' || t == '[') depth++;
+                else if (t == '}' || t == ']') depth--;
+                else if (t == '\0') return false;
+            } while (depth > 0);
+            return true;
+        }
+        return t == ',' || t == '}' || t == ']';
+    }
+
+    std::string_view m_json;
+    const std::vector<uint32_t>& m_s;
+    const std::string_view* m_paths;
+    size_t m_count;
+    std::string_view* m_out;
+    size_t m_i = 0;
+    size_t m_found = 0;
+};
+
+size_t JsonIndex::Lookup(std::initializer_list<std::string_view> paths, std::string_view* out) const {
+    size_t count = std::min(paths.size(), Walker::kMaxPaths);
+    size_t consumed[Walker::kMaxPaths];
+    for (size_t j = 0; j < paths.size(); ++j) out[j] = {};
+    for (size_t j = 0; j < count; ++j) consumed[j] = 0;
+    if (m_structurals.empty() || count == 0) return 0;
+
+    Walker walker(*this, paths.begin(), count, out);
+    walker.Object(0, consumed); // a malformed tail only loses the fields not found before it
+    return walker.Found();
+}
+
+// ----------------- Unescape -----------------
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+static bool ReadHex4(std::string_view s, size_t pos, uint32_t& value) {
+    if (pos + 4 > s.size()) return false;
+    value = 0;
+    for (size_t i = pos; i < pos + 4; ++i) {
+        char c = s[i];
+        uint32_t digit = c >= '0' && c <= '9' ? c - '0' : (c | 0x20) >= 'a' && (c | 0x20) <= 'f' ? (c | 0x20) - 'a' + 10 : 16;
+        if (digit == 16) return false;
+        value = value << 4 | digit;
+    }
+    return true;
+}
+
+std::string JsonIndex::Unescape(std::string_view raw) {
+    size_t slash = raw.find('\\');
+    if (slash == std::string_view::npos) return std::string(raw);
+
+    std::string out(raw.substr(0, slash));
+    out.reserve(raw.size());
+    for (size_t i = slash; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c != '\\' || i + 1 == raw.size()) {
+            out.push_back(c);
+            continue;
+        }
+        char e = raw[++i];
+        switch (e) {
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+            uint32_t cp;
+            if (!ReadHex4(raw, i + 1, cp)) {
+                out.append("\\u");
+                break;
+            }
+            i += 4;
+            uint32_t low;
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u' &&
+                ReadHex4(raw, i + 3, low) && low >= 0xDC00 && low < 0xE000) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            } else if (cp >= 0xD800 && cp < 0xE000) {
+                cp = 0xFFFD; // lone surrogate
+            }
+            AppendUtf8(out, cp);
+            break;
+        }
+        default: out.push_back(e); // " \ /
+        }
+    }
+    return out;
+}
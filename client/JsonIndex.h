@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Field lookup in a JSON document without parsing it into a tree. Build() makes one pass that
+// records the offset of every structural character ({ } [ ] : , and unescaped quotes) outside
+// strings, classifying 64 bytes at a time with SSE2 bitmasks (a byte loop elsewhere) and finding
+// in-string regions with a prefix XOR over the quote bits. Lookup() then walks only those offsets,
+// skipping subtrees no requested path leads into, and resolves several fields in one walk.
+//
+// Paths are object keys joined by dots and are matched against the keys actually present, so a
+// key containing dots still works: "well_known.m.homeserver.base_url". Keys are compared as
+// written in the document (escapes not decoded). Arrays are not entered.
+// Found values are views into the document: string contents without the quotes and still
+// escaped (see Unescape), other values as written (numbers, true/false/null, whole {...} / [...]).
+// At most 16 paths per Lookup().
+class JsonIndex {
+public:
+    // `json` must outlive the index. False for unterminated strings or a document that is not an
+    // object; structure is otherwise checked only as far as lookups walk.
+    bool Build(std::string_view json);
+
+    // out[i] receives the value at paths[i], or a null view (data() == nullptr) when absent.
+    // Returns how many were found. The first occurrence of a duplicated key wins.
+    size_t Lookup(std::initializer_list<std::string_view> paths, std::string_view* out) const;
+
+    std::string_view Find(std::string_view path) const {
+        std::string_view value;
+        Lookup({ path }, &value);
+        return value;
+    }
+
+    // Decodes the escapes of a string value found by Lookup(), \uXXXX (and surrogate pairs) to UTF-8
+    static std::string Unescape(std::string_view raw);
+
+    size_t StructuralCount() const { return m_structurals.size(); }
+
+private:
+    class Walker;
+
+    std::string_view m_json;
+    std::vector<uint32_t> m_structurals; // byte offsets, ascending
+};
@@ -0,0 +1,136 @@
+#include "JsonWriter.h"
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_ESCAPE_SSE2 1
+#endif
+
+static bool NeedsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+// True if any byte of `w` is < 0x20, '"' or '\\'. May not say which; the caller rescans bytewise.
+static bool HasSpecial(uint64_t w) {
+    constexpr uint64_t ones = 0x0101010101010101ull;
+    constexpr uint64_t highs = 0x8080808080808080ull;
+    auto hasZero = [](uint64_t v) { return (v - ones) & ~v & highs; };
+    uint64_t below20 = (w - ones * 0x20) & ~w & highs;
+    return (below20 | hasZero(w ^ (ones * '"')) | hasZero(w ^ (ones * '\\'))) != 0;
+}
+
+// Length of the leading run of `s` that can be copied as is
+static size_t CleanRun(const char* s, size_t n) {
+    size_t i = 0;
+#ifdef JSON_ESCAPE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, control), control)); // v <= 0x1F
+        if (int mask = _mm_movemask_epi8(special)) return i + std::countr_zero(static_cast<unsigned>(mask));
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, s + i, sizeof(w));
+        if (HasSpecial(w)) break;
+    }
+    while (i < n && !NeedsEscape(static_cast<unsigned char>(s[i]))) ++i;
+    return i;
+}
+
+void JsonWriter::AppendString(std::string& out, std::string_view s) {
+    static constexpr char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    while (!s.empty()) {
+        size_t clean = CleanRun(s.data(), s.size());
+        out.append(s.data(), clean);
+        if (clean == s.size()) break;
+
+        auto c = static_cast<unsigned char>(s[clean]);
+        s.remove_prefix(clean + 1);
+        switch (c) {
+        case '"':  out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default: {
+            char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            out.append(u, sizeof(u));
+        }
+        }
+    }
+    out.push_back('"');
+}
+
+JsonWriter& JsonWriter::BeginObject() {
+    Separator();
+    m_out.push_back('{');
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+    m_out.push_back('}');
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+    Separator();
+    m_out.push_back('[');
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+    m_out.push_back(']');
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key) {
+    Separator();
+    AppendString(m_out, key);
+    m_out.push_back(':');
+    m_needComma = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(std::string_view value) {
+    Separator();
+    AppendString(m_out, value);
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    Separator();
+    char buf[24];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    m_out.append(buf, end);
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    Separator();
+    m_out.append(value ? "true" : "false");
+    m_needComma = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    Separator();
+    m_out.append("null");
+    m_needComma = true;
+    return *this;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Streaming JSON writer appending to a caller-owned string, so a buffer kept across requests
+// stops allocating once it has grown to the largest body. Strings are escaped per RFC 8259;
+// runs of bytes that need no escaping are found 16 (SSE2) or 8 (word scan) bytes at a time and
+// copied in one go. Bytes >= 0x80 pass through: input is expected to be UTF-8.
+//
+//     JsonWriter(body).BeginObject().Field("msgtype", "m.text").Field("body", text).EndObject();
+class JsonWriter {
+public:
+    // Clears `out` but keeps its capacity
+    explicit JsonWriter(std::string& out) : m_out(out) { m_out.clear(); }
+
+    JsonWriter& BeginObject();
+    JsonWriter& EndObject();
+    JsonWriter& BeginArray();
+    JsonWriter& EndArray();
+
+    JsonWriter& Key(std::string_view key);
+    JsonWriter& String(std::string_view value);
+    JsonWriter& Int(int64_t value);
+    JsonWriter& Bool(bool value);
+    JsonWriter& Null();
+
+    JsonWriter& Field(std::string_view key, std::string_view value) { return Key(key).String(value); }
+
+    // `s` as a quoted, escaped JSON string
+    static void AppendString(std::string& out, std::string_view s);
+
+private:
+    void Separator() {
+        if (m_needComma) m_out.push_back(',');
+    }
+
+    std::string& m_out;
+    bool m_needComma = false; // a value was just completed at the current level
+};
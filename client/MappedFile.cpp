@@ -0,0 +1,145 @@
+#include "MappedFile.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::filesystem::path& path) {
+    Close();
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    m_file = file;
+    return true;
+}
+
+void MappedFile::Close() {
+    Unmap();
+    if (m_file) CloseHandle(m_file);
+    m_file = nullptr;
+}
+
+bool MappedFile::IsOpen() const {
+    return m_file != nullptr;
+}
+
+uint64_t MappedFile::Size() const {
+    LARGE_INTEGER size{};
+    if (!m_file || !GetFileSizeEx(m_file, &size)) return 0;
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+bool MappedFile::Write(uint64_t offset, const void* data, size_t size) {
+    auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(m_file, p, chunk, &written, &at) || written == 0) return false;
+        p += written;
+        offset += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool MappedFile::Truncate(uint64_t size) {
+    Unmap();
+    LARGE_INTEGER to{};
+    to.QuadPart = static_cast<LONGLONG>(size);
+    return SetFilePointerEx(m_file, to, nullptr, FILE_BEGIN) && SetEndOfFile(m_file);
+}
+
+bool MappedFile::Map() {
+    Unmap();
+    uint64_t size = Size();
+    if (size == 0 || size > SIZE_MAX) return false;
+    HANDLE mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // the view keeps the mapping alive
+    if (!view) return false;
+    m_view = static_cast<const char*>(view);
+    m_viewSize = static_cast<size_t>(size);
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if (m_view) UnmapViewOfFile(m_view);
+    m_view = nullptr;
+    m_viewSize = 0;
+}
+#else
+bool MappedFile::Open(const std::filesystem::path& path) {
+    Close();
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    return m_fd >= 0;
+}
+
+void MappedFile::Close() {
+    Unmap();
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+}
+
+bool MappedFile::IsOpen() const {
+    return m_fd >= 0;
+}
+
+uint64_t MappedFile::Size() const {
+    struct stat st{};
+    if (m_fd < 0 || ::fstat(m_fd, &st) != 0) return 0;
+    return static_cast<uint64_t>(st.st_size);
+}
+
+bool MappedFile::Write(uint64_t offset, const void* data, size_t size) {
+    auto* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(m_fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool MappedFile::Truncate(uint64_t size) {
+    Unmap();
+    return ::ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+}
+
+bool MappedFile::Map() {
+    Unmap();
+    uint64_t size = Size();
+    if (size == 0 || size > SIZE_MAX) return false;
+    void* view = ::mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, m_fd, 0);
+    if (view == MAP_FAILED) return false;
+    m_view = static_cast<const char*>(view);
+    m_viewSize = static_cast<size_t>(size);
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if (m_view) ::munmap(const_cast<char*>(m_view), m_viewSize);
+    m_view = nullptr;
+    m_viewSize = 0;
+}
+#endif
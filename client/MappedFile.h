@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// A file opened for reading and writing plus a read-only memory map of it (mmap on POSIX,
+// CreateFileMapping on Windows). Writes go through the file, not the map; the view is coherent
+// with them up to its own length, so Map() again after growing the file to see the new bytes.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Created if missing
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const;
+
+    // Current length of the file, which may be past the mapped length
+    uint64_t Size() const;
+    bool Write(uint64_t offset, const void* data, size_t size);
+    // Drops the view first: Windows cannot shrink a mapped file
+    bool Truncate(uint64_t size);
+
+    // Maps the whole file as it is now, replacing the previous view. False for an empty file.
+    bool Map();
+    void Unmap();
+    const char* Data() const { return m_view; }
+    size_t MappedSize() const { return m_viewSize; }
+
+private:
+#ifdef _WIN32
+    void* m_file = nullptr; // HANDLE
+#else
+    int m_fd = -1;
+#endif
+    const char* m_view = nullptr;
+    size_t m_viewSize = 0;
+};
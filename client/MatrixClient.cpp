@@ -1,21 +1,25 @@
 #include "MatrixClient.h"
+#include "WinHttpTransport.h"
+#include "SyncParser.h"
+#include "JsonIndex.h"
+#include "JsonWriter.h"
 #include "../Utils.h"
 #include <windows.h>
 #include <shellapi.h>
 #include <winhttp.h>
+#include <algorithm>
+#include <cctype>
 #include <string>
 #include <sstream>
 #include <thread>
 #include <future>
-#include "nlohmann/json.hpp"
 
 #pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "winhttp.lib")
 #pragma comment(lib, "Crypt32.lib")
 
 #define WM_MATRIX_MESSAGE (WM_APP + 100)
-
-using json = nlohmann::json;
+#define WM_MATRIX_SEND_FAILED (WM_APP + 101)
 
 inline void ShowError(const std::wstring& title, const std::wstring& msg) {
     MessageBoxW(NULL, msg.c_str(), title.c_str(), MB_ICONERROR | MB_OK);
@@ -23,46 +27,34 @@ inline void ShowError(const std::wstring& title, const std::wstring& msg) {
 
 // ------------------ Constructor / Destructor ------------------
 MatrixClient::MatrixClient(const std::wstring& homeserver)
-    : m_homeserver(homeserver) {}
+    : MatrixClient(homeserver, [&homeserver] { return std::make_unique<WinHttpTransport>(homeserver); }) {}
+
+MatrixClient::MatrixClient(const std::wstring& homeserver, const TransportFactory& makeTransport)
+    : m_homeserver(homeserver), m_http(makeTransport()), m_syncHttp(makeTransport()),
+      m_receipts([this](const std::string& roomId, const std::string& eventId) { return SendReadReceipt(roomId, eventId); }),
+      m_sender(*m_http, m_workers) {
+    // Runs on a pool thread, possibly while Stop() drains the queue: no dialog here, the chat
+    // window shows the failure on its own thread
+    m_sender.SetOnFailure([this](const std::string& roomId, const std::string&, int) {
+        if (!m_chatWindowHandle) return;
+        auto* data = new std::string(roomId);
+        if (!PostMessage(m_chatWindowHandle, WM_MATRIX_SEND_FAILED, 0, (LPARAM)data)) delete data;
+    });
+}
 
-MatrixClient::~MatrixClient() { Stop(); }
+MatrixClient::~MatrixClient() {
+    Stop();
+    // Also when never started: queued drains still use m_http
+    m_sender.Stop();
+    m_workers.Stop();
+}
 
 
 // ------------------ JSON Helper ------------------
 std::string MatrixClient::ExtractJsonValue(const std::string& json, const std::string& key) {
-    std::string pattern = "\"" + key + "\":";
-    auto pos = json.find(pattern);
-    if (pos == std::string::npos) return {};
-    pos += pattern.size();
-
-    // Skip whitespace
-    while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t')) pos++;
-
-    // String value
-    if (pos < json.size() && json[pos] == '"') {
-        pos++;
-        std::string value;
-        bool escape = false;
-        for (; pos < json.size(); ++pos) {
-            char c = json[pos];
-            if (escape) {
-                value.push_back(c);
-                escape = false;
-            } else if (c == '\\') {
-                escape = true;
-            } else if (c == '"') {
-                break;
-            } else {
-                value.push_back(c);
-            }
-        }
-        return value;
-    }
-
-    // Non-string (numbers, bool, null)
-    size_t end = json.find_first_of(",}\n", pos);
-    if (end == std::string::npos) end = json.size();
-    return json.substr(pos, end - pos);
+    JsonIndex index;
+    if (!index.Build(json)) return {};
+    return JsonIndex::Unescape(index.Find(key));
 }
 
 
@@ -80,10 +72,10 @@ bool MatrixClient::PerformLogin() {
     if (auto creds = LoadCredentialsEncrypted()) {
         m_accessToken = creds->first;
         m_userId = creds->second;
+        m_sender.SetAccessToken(m_accessToken);
 
-        // Verify token
-        auto resp = HttpRequest(L"GET", L"/_matrix/client/r0/account/whoami", "", true);
-        if (!resp.empty() && resp.find(m_userId) != std::string::npos) {
+        // Verify token, rejoining and syncing meanwhile
+        if (ResumeSession()) {
             if (onLogin_) onLogin_(true);
             return true;
         }
@@ -98,7 +90,8 @@ bool MatrixClient::PerformLogin() {
     }
 
     std::string loginToken = *tokenOpt;
-    std::string body = "{\"type\":\"m.login.token\",\"token\":\"" + loginToken + "\"}";
+    std::string body;
+    JsonWriter(body).BeginObject().Field("type", "m.login.token").Field("token", loginToken).EndObject();
     auto resp = HttpRequest(L"POST", L"/_matrix/client/r0/login", body);
 
     if (resp.empty()) {
@@ -107,8 +100,13 @@ bool MatrixClient::PerformLogin() {
         return false;
     }
 
-    m_accessToken = ExtractJsonValue(resp, "access_token");
-    m_userId = ExtractJsonValue(resp, "user_id");
+    // Both fields in one pass over the response
+    JsonIndex index;
+    std::string_view fields[2];
+    if (index.Build(resp)) index.Lookup({ "access_token", "user_id" }, fields);
+    m_accessToken = JsonIndex::Unescape(fields[0]);
+    m_userId = JsonIndex::Unescape(fields[1]);
+    m_sender.SetAccessToken(m_accessToken);
 
     if (m_accessToken.empty()) {
         ShowError(L"Login Error", L"Access token not found in response.");
@@ -119,11 +117,55 @@ bool MatrixClient::PerformLogin() {
     // Save encrypted for next time
     SaveCredentialsEncrypted(m_accessToken, m_userId);
 
+    RegisterSyncFilter();
+    OpenTimelineStore();
     if (onLogin_) onLogin_(true);
     return true;
 }
 
 
+bool MatrixClient::ResumeSession() {
+    m_syncFilterId = CachedSyncFilter();
+    m_nextBatch = LoadSyncToken(m_userId).value_or("");
+    auto lastRoom = LoadLastRoomLink();
+
+    // Sent on the assumption that the token is still valid; on m_http, whose timeouts suit a sync
+    // with timeout=0, while m_syncHttp stays untouched until Start()
+    auto join = std::async(std::launch::async, [this, &lastRoom]() -> HttpResponse {
+        if (!lastRoom) return {};
+        return m_http->Request("POST", "/_matrix/client/r0/join/" + *lastRoom, "{}", m_accessToken);
+    });
+    auto sync = std::async(std::launch::async, [this] {
+        return m_http->Request("GET", SyncPath(std::chrono::milliseconds(0)), "", m_accessToken);
+    });
+    m_store.Open(GetTimelineDir(m_userId)); // mapped from disk while the requests are out
+
+    auto whoami = m_http->Request("GET", "/_matrix/client/r0/account/whoami", "", m_accessToken);
+    HttpResponse joined = join.get();
+    HttpResponse synced = sync.get();
+    if (whoami.status != 200 || ExtractJsonValue(whoami.body, "user_id") != m_userId) {
+        // Nothing of the optimistic requests is kept; SSO may log in someone else
+        m_store.Close();
+        m_nextBatch.clear();
+        return false;
+    }
+
+    if (m_syncFilterId.empty()) RegisterSyncFilter(); // not cached: this first sync ran unfiltered
+    OpenTimelineStore();  // stored history first, then what arrived since
+    ProcessSync(synced);  // on failure SyncLoop() starts from the stored token instead
+    if (joined.status == 200) m_resumedRoomId = ExtractJsonValue(joined.body, "room_id");
+    return true;
+}
+
+bool MatrixClient::EnterResumedRoom() {
+    if (m_resumedRoomId.empty()) return false;
+    std::string roomId = std::move(m_resumedRoomId);
+    m_resumedRoomId.clear();
+    SwitchRoom(roomId);
+    return true;
+}
+
+
 // ------------------ Async SSO Login ------------------
 std::future<bool> MatrixClient::LoginWithSSOAsync() {
     return std::async(std::launch::async, [this]() -> bool {
@@ -143,10 +185,12 @@ std::future<bool> MatrixClient::LoginWithSSOAndRandomRoomAsync() {
         std::string randomRoomAlias =
             "room_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
 
-        std::string createBody =
-            "{\"room_alias_name\":\"" + randomRoomAlias + "\", "
-            "\"visibility\":\"public\", "
-            "\"preset\":\"private_chat\"}"; // keeps history and power levels limited
+        std::string createBody;
+        JsonWriter(createBody).BeginObject()
+            .Field("room_alias_name", randomRoomAlias)
+            .Field("visibility", "public")
+            .Field("preset", "private_chat") // keeps history and power levels limited
+            .EndObject();
         auto createResp = HttpRequest(L"POST", L"/_matrix/client/r0/createRoom", createBody, true);
 
         std::string roomId = ExtractJsonValue(createResp, "room_id");
@@ -191,29 +235,42 @@ bool MatrixClient::JoinRoom(const std::string& roomIdOrAlias) {
         return false;
     }
 
-    m_currentRoomId = roomId;
+    SwitchRoom(roomId);
     SaveLastRoomLink(roomIdOrAlias); // ✅ save last room link
+    if (m_running) RequestSync(); // don't wait out the current long poll for the new room
     return true;
 }
 
 
 
-void MatrixClient::SendMessageAsync(const std::string& roomId, const std::string& text) {
-    LaunchTask([this, roomId, text]() {
-        std::string txnId = std::to_string(::GetTickCount64());
-        std::wstring path = L"/_matrix/client/r0/rooms/" +
-                            std::wstring(roomId.begin(), roomId.end()) +
-                            L"/send/m.room.message/" +
-                            std::wstring(txnId.begin(), txnId.end());
-
-        std::string body = "{\"msgtype\":\"m.text\",\"body\":\"" + text + "\"}";
-        auto resp = HttpRequest(L"PUT", path, body, true);
-
-        if (resp.empty()) {
-            ShowError(L"Send Message Error", L"Failed to send message to room: " +
-                      std::wstring(roomId.begin(), roomId.end()));
+bool MatrixClient::SwitchRoom(const std::string& roomId) {
+    m_currentRoomId = roomId;
+    std::string newest;
+    bool cached = m_timelines.SetActive(roomId, [this, &roomId, &newest](const RoomMessage& msg) {
+        if (m_onMessage && m_chatWindowHandle) {
+            PostToChat(roomId, msg.body);
+            newest = msg.eventId;
         }
     });
+    // The replayed backlog is now on screen
+    if (!newest.empty()) m_receipts.Mark(roomId, newest);
+    return cached;
+}
+
+void MatrixClient::PostToChat(const std::string& roomId, const std::string& body) {
+    auto* data = new std::string(roomId + "|" + body);
+    PostMessage(m_chatWindowHandle, WM_MATRIX_MESSAGE, 0, (LPARAM)data);
+}
+
+void MatrixClient::SendMessageAsync(const std::string& roomId, const std::string& text) {
+    std::string body;
+    body.reserve(text.size() + 32);
+    JsonWriter(body).BeginObject().Field("msgtype", "m.text").Field("body", text).EndObject();
+    // Queued behind this room's earlier messages; failures are reported by m_sender
+    if (m_sender.Send(roomId, std::move(body)).empty()) {
+        ShowError(L"Send Message Error", L"Too many messages waiting to be sent to room: " +
+                  std::wstring(roomId.begin(), roomId.end()));
+    }
 }
 
 
@@ -221,6 +278,14 @@ void MatrixClient::SendMessageAsync(const std::string& roomId, const std::string
 void MatrixClient::Start() {
     if (m_running) return;
     m_running = true;
+    m_syncScheduler.SetPolicy(m_syncPolicy);
+    m_syncScheduler.Reset();
+    // The server holds the poll for longPollTimeout; leave room for the response on top. Neither
+    // Stop() nor RequestSync() waits that out: CancelAll() aborts the held poll.
+    m_syncHttp->SetTimeout(m_syncPolicy.longPollTimeout + std::chrono::seconds(15));
+    m_receipts.Start();
+    m_workers.Start();
+    m_sender.Start();
     m_thread = std::thread(&MatrixClient::SyncLoop, this);
 }
 
@@ -228,114 +293,216 @@ void MatrixClient::Stop() {
     if (!m_running) return;
     m_running = false;
 
-    // Cancel any pending HTTP request
-    {
-        std::lock_guard<std::mutex> lock(m_httpMutex);
-        if (m_hRequest) {
-            ::WinHttpCloseHandle(m_hRequest);
-            m_hRequest = nullptr;
-        }
-    }
+    // Abort the held long poll and any other request at once
+    m_syncScheduler.Stop();
+    m_syncHttp->CancelAll();
+    m_http->CancelAll();
 
     if (m_thread.joinable())
         m_thread.join();
+    if (m_nextBatchUnsaved) SaveNextBatch(true);
 
-    // Wait for all async tasks
-    {
-        std::lock_guard<std::mutex> lock(m_tasksMutex);
-        for (auto& task : m_tasks) {
-            if (task.valid()) task.wait();
-        }
-        m_tasks.clear();
-    }
+    // Queued sends get one more try each, without retry waits
+    m_sender.Stop();
+    m_workers.Stop();
+
+    // Last, on a transport no longer being cancelled: one try at the receipts still pending
+    m_receipts.Stop();
+    m_store.Flush();
+}
+
+
+
+bool MatrixClient::SendReadReceipt(const std::string& roomId, const std::string& eventId) {
+    std::string path = "/_matrix/client/r0/rooms/" + roomId + "/read_markers";
+    static thread_local std::string body; // reused across receipts from the same thread
+    JsonWriter(body).BeginObject().Field("m.fully_read", eventId).Field("m.read", eventId).EndObject();
+
+    return m_http->Request("POST", path, body, m_accessToken).status == 200;
 }
 
 
+// ------------------ Sync Filter ------------------
+// Only what SyncOnce reads: m.room.message timelines of joined rooms, capped, with member state
+// lazy-loaded for the senders in them and every event trimmed to the fields SyncParser keeps
+static const std::string kSyncFilter =
+    R"({"presence":{"not_types":["*"]},"account_data":{"not_types":["*"]},)"
+    R"("room":{"account_data":{"not_types":["*"]},"ephemeral":{"not_types":["*"]},)"
+    R"("state":{"types":["m.room.member"],"lazy_load_members":true},)"
+    R"("timeline":{"types":["m.room.message"],"limit":20,"lazy_load_members":true}},)"
+    R"("event_fields":["type","sender","event_id","origin_server_ts","content.msgtype","content.body"]})";
 
-void MatrixClient::SendReadReceipt(const std::string& roomId, const std::string& eventId) {
-    std::wstring path = L"/_matrix/client/r0/rooms/" +
-        std::wstring(roomId.begin(), roomId.end()) +
-        L"/receipt/m.read/" +
-        std::wstring(eventId.begin(), eventId.end());
+std::string MatrixClient::CachedSyncFilter() const {
+    return LoadSyncFilter(m_userId, kSyncFilter).value_or("");
+}
+
+void MatrixClient::RegisterSyncFilter() {
+    if (auto cached = LoadSyncFilter(m_userId, kSyncFilter)) {
+        m_syncFilterId = *cached;
+        return;
+    }
 
-    HttpRequest(L"POST", path, "{}", true);
+    std::wstring path = L"/_matrix/client/r0/user/" + ToWString(m_userId) + L"/filter";
+    auto resp = HttpRequest(L"POST", path, kSyncFilter, true);
+    m_syncFilterId = ExtractJsonValue(resp, "filter_id");
+    if (!m_syncFilterId.empty()) SaveSyncFilter(m_userId, kSyncFilter, m_syncFilterId);
+    // On failure syncs simply run unfiltered
 }
 
+void MatrixClient::RequestSync() {
+    // The held poll is aborted and the next one asks for timeout=0, so e.g. a just-joined room
+    // gets its first sync at once
+    m_syncScheduler.Wake();
+    m_syncHttp->CancelAll();
+}
 
-void MatrixClient::SyncOnce() {
-    std::wstring path = L"/_matrix/client/r0/sync?timeout=3000";
+std::string MatrixClient::SyncPath(std::chrono::milliseconds timeout) const {
+    std::string path = "/_matrix/client/r0/sync?timeout=" + std::to_string(timeout.count());
+    if (!m_syncFilterId.empty()) {
+        path += "&filter=" + m_syncFilterId;
+    }
     if (!m_nextBatch.empty()) {
-        path += L"&since=" + std::wstring(m_nextBatch.begin(), m_nextBatch.end());
+        path += "&since=" + m_nextBatch;
     }
+    return path;
+}
 
-    auto resp = HttpRequest(L"GET", path, "", true);
-    if (resp.empty()) return;
+// errcode and error message of a Matrix error response; both empty for anything else
+struct MatrixError {
+    std::string errcode;
+    std::string error;
+};
+
+static MatrixError ParseMatrixError(const HttpResponse& response) {
+    MatrixError err;
+    if (response.status < 400) return err;
+    JsonIndex index;
+    std::string_view fields[2];
+    if (index.Build(response.body)) index.Lookup({ "errcode", "error" }, fields);
+    err.errcode = JsonIndex::Unescape(fields[0]);
+    err.error = JsonIndex::Unescape(fields[1]);
+    return err;
+}
 
-    try {
-        json j = json::parse(resp);
+// Whether the error message names `word` (lower case), in any case
+static bool Mentions(const std::string& message, std::string_view word) {
+    auto it = std::search(message.begin(), message.end(), word.begin(), word.end(),
+                          [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+    return it != message.end();
+}
 
-        // Save next_batch for incremental sync
-        if (j.contains("next_batch") && j["next_batch"].is_string()) {
-            m_nextBatch = j["next_batch"].get<std::string>();
-        }
+// The cached filter ID is unknown to the server, or rejected as the filter parameter
+static bool IsStaleFilterError(int status, const MatrixError& err) {
+    if (status == 404) return err.errcode == "M_NOT_FOUND";
+    return status == 400 && err.errcode == "M_INVALID_PARAM" && Mentions(err.error, "filter");
+}
 
-        // We only care about current room
-        if (m_currentRoomId.empty()) return;
-        if (!j.contains("rooms") || !j["rooms"].contains("join")) return;
+// The since token is rejected (servers word it "since" or "stream token"), not the filter
+static bool IsStaleSinceError(int status, const MatrixError& err) {
+    return status == 400 && (Mentions(err.error, "since") || Mentions(err.error, "token")) && !Mentions(err.error, "filter");
+}
 
-        auto joinObj = j["rooms"]["join"];
-        if (!joinObj.contains(m_currentRoomId)) return;
+// False when the sync failed and the scheduler should back off
+bool MatrixClient::SyncOnce() {
+    auto timeout = m_syncScheduler.NextTimeout(m_nextBatch.empty());
+    return ProcessSync(m_syncHttp->Request("GET", SyncPath(timeout), "", m_accessToken));
+}
 
-        const auto& roomData = joinObj[m_currentRoomId];
-        if (!roomData.is_object()) return;
-        if (!roomData.contains("timeline")) return;
+bool MatrixClient::ProcessSync(const HttpResponse& response) {
+    const std::string& resp = response.body;
+    if (resp.empty()) return false;
+
+    if (response.status >= 400) {
+        MatrixError err = ParseMatrixError(response);
+        // A cached filter the server no longer knows: register it once more, or sync unfiltered.
+        // Checked first: the stored since token is still good then.
+        if (!m_syncFilterId.empty() && IsStaleFilterError(response.status, err)) {
+            std::error_code ec;
+            std::filesystem::remove(GetSyncFilterPath(), ec);
+            m_syncFilterId.clear();
+            RegisterSyncFilter();
+            return true;
+        }
+        // A stored since token the server rejects: fall back to an initial sync
+        if (!m_nextBatch.empty() && IsStaleSinceError(response.status, err)) {
+            m_nextBatch.clear();
+            return true;
+        }
+        return false; // left to the scheduler's backoff
+    }
 
-        const auto& timeline = roomData["timeline"];
-        if (!timeline.is_object() || !timeline.contains("events")) return;
+    // Streamed: only next_batch and the joined rooms' timelines are materialized
+    SyncBatch batch;
+    if (!ParseSync(resp, [](std::string_view) { return true; }, batch))
+        return false; // ignore parsing errors
+    if (batch.nextBatch.empty()) return false;
 
-        const auto& events = timeline["events"];
-        if (!events.is_array()) return;
+    // Save next_batch for incremental sync, also for the next launch
+    m_nextBatch = std::move(batch.nextBatch);
+    SaveNextBatch(false);
 
-        for (const auto& ev : events) {
-            if (!ev.is_object()) continue;
-            if (ev.value("type", "") != "m.room.message") continue;
+    for (const auto& ev : batch.events) {
+        if (ev.type != "m.room.message") continue;
+        if (ev.msgtype != "m.text") continue;
 
-            const auto& content = ev["content"];
-            if (!content.is_object()) continue;
-            if (content.value("msgtype", "") != "m.text") continue;
+        // Skip if the sender is us
+        if (!ev.sender.empty() && ev.sender == m_userId) {
+            continue;
+        }
+        if (ev.body.empty()) continue;
 
-            // Skip if the sender is us
-            std::string sender = ev.value("sender", "");
-            if (!sender.empty() && sender == m_userId) {
-                continue;
-            }
+        // Stored last session and already in the backlog: an initial sync overlaps what was kept
+        if (!m_store.Append(ev.roomId, ev.eventId, ev.sender, ev.body, ev.originServerTs)) continue;
 
-            std::string body = content.value("body", "");
-            std::string eventId = ev.value("event_id", "");
+        // Every room keeps its backlog; only the active one reaches the overlay now
+        if (!m_timelines.Append(ev.roomId, { ev.eventId, ev.sender, ev.body, ev.originServerTs })) continue;
 
-            if (!body.empty() && m_onMessage && m_chatWindowHandle) {
-                auto* data = new std::string(m_currentRoomId + "|" + body);
-                PostMessage(m_chatWindowHandle, WM_MATRIX_MESSAGE, 0, (LPARAM)data);
+        if (m_onMessage && m_chatWindowHandle) {
+            PostToChat(ev.roomId, ev.body);
 
-                // Mark as read
-                if (!eventId.empty()) {
-                    SendReadReceipt(m_currentRoomId, eventId);
-                }
+            // Mark as read; a burst of messages ends up as one receipt for the newest
+            if (!ev.eventId.empty()) {
+                m_receipts.Mark(ev.roomId, ev.eventId);
             }
         }
+    }
+    return true;
+}
 
-    } catch (...) {
-        // ignore parsing errors
+void MatrixClient::SaveNextBatch(bool force) {
+    // Long polls return with every message, so the file is rewritten only every so often. A token
+    // that lags behind re-delivers at most the filter's timeline limit per room on the next launch,
+    // which is within the store's resume window: the repeats are refused as duplicates.
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - m_nextBatchSavedAt < kSyncTokenSaveInterval) {
+        m_nextBatchUnsaved = true;
+        return;
     }
+    if (!m_nextBatch.empty()) SaveSyncToken(m_userId, m_nextBatch);
+    m_nextBatchSavedAt = now;
+    m_nextBatchUnsaved = false;
 }
 
 void MatrixClient::SyncLoop() {
-    // Matches your Python pattern: long-poll then a small sleep before next poll.
-    while (m_running) {
-        SyncOnce();
-        // Python used `time.sleep(1)` after each sync loop.
-        // This keeps behaviour similar and avoids tight loops if server returns quickly.
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Long-poll back to back; m_syncScheduler only holds the next poll back after failures
+    while (m_running && m_syncScheduler.WaitForTurn()) {
+        if (SyncOnce()) m_syncScheduler.OnSuccess();
+        else m_syncScheduler.OnFailure();
+    }
+}
+
+
+
+// ------------------ Local History ------------------
+void MatrixClient::OpenTimelineStore() {
+    if (!m_store.IsOpen() && !m_store.Open(GetTimelineDir(m_userId))) return; // then history lasts this session only
+    if (m_timelines.RoomCount() > 0) return; // seeded by an earlier login
+
+    // The newest messages of each room, mapped from disk; SwitchRoom() replays them like synced ones
+    for (const auto& roomId : m_store.Rooms()) {
+        m_store.ForEachRecent(roomId, m_timelines.Capacity(), [&](const TimelineRecord& r) {
+            m_timelines.Append(roomId, { std::string(r.eventId), std::string(r.sender), std::string(r.body), r.originServerTs });
+        });
     }
 }
 
@@ -347,63 +514,10 @@ std::string MatrixClient::HttpRequest(const std::wstring& method,
                                      const std::string& body,
                                      bool auth)
 {
-    HINTERNET hSession = ::WinHttpOpen(L"MatrixClient/1.0",
-                                      WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                                      WINHTTP_NO_PROXY_NAME,
-                                      WINHTTP_NO_PROXY_BYPASS, 0);
-    if (!hSession) { ShowError(L"HTTP Error", L"Failed to open WinHTTP session."); return {}; }
-
-    HINTERNET hConnect = ::WinHttpConnect(hSession, m_homeserver.c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0);
-    if (!hConnect) { ::WinHttpCloseHandle(hSession); ShowError(L"HTTP Error", L"Failed to connect to server."); return {}; }
-
-    {
-        std::lock_guard<std::mutex> lock(m_httpMutex);
-        m_hRequest = ::WinHttpOpenRequest(hConnect, method.c_str(), path.c_str(),
-                                          NULL, WINHTTP_NO_REFERER,
-                                          WINHTTP_DEFAULT_ACCEPT_TYPES,
-                                          WINHTTP_FLAG_SECURE);
-    }
-
-    if (!m_hRequest) { ::WinHttpCloseHandle(hConnect); ::WinHttpCloseHandle(hSession); ShowError(L"HTTP Error", L"Failed to create HTTP request."); return {}; }
-
-    std::wstring headers;
-    if (auth && !m_accessToken.empty()) {
-        std::string token = "Authorization: Bearer " + m_accessToken;
-        headers = std::wstring(token.begin(), token.end());
-    }
-
-    BOOL bResults = ::WinHttpSendRequest(m_hRequest,
-                                         headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
-                                         (DWORD)-1L,
-                                         body.empty() ? WINHTTP_NO_REQUEST_DATA : (LPVOID)body.data(),
-                                         (DWORD)body.size(),
-                                         (DWORD)body.size(),
-                                         0);
-
-    std::string result;
-    if (bResults && ::WinHttpReceiveResponse(m_hRequest, NULL)) {
-        DWORD dwSize = 0;
-        do {
-            DWORD dwDownloaded = 0;
-            if (!::WinHttpQueryDataAvailable(m_hRequest, &dwSize)) break;
-            if (dwSize == 0) break;
-            std::string buffer(dwSize, 0);
-            if (!::WinHttpReadData(m_hRequest, buffer.data(), dwSize, &dwDownloaded)) break;
-            buffer.resize(dwDownloaded);
-            result += buffer;
-        } while (dwSize > 0);
-    } else {
-        // ShowError(L"HTTP Error", L"Failed to send or receive HTTP request."); // optional
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(m_httpMutex);
-        ::WinHttpCloseHandle(m_hRequest);
-        m_hRequest = nullptr;
-    }
-    ::WinHttpCloseHandle(hConnect);
-    ::WinHttpCloseHandle(hSession);
-    return result;
+    // Keep-alive connections are reused across calls; see WinHttpTransport
+    auto response = m_http->Request(ToString(method), ToString(path), body,
+                                    auth ? std::string_view(m_accessToken) : std::string_view());
+    return response.body;
 }
 
 
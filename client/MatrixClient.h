@@ -12,7 +12,15 @@
 #include <shlobj.h> // SHGetFolderPath
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <../Utils.h>
+#include "HttpTransport.h"
+#include "SyncScheduler.h"
+#include "ReceiptCoalescer.h"
+#include "RoomTimelines.h"
+#include "TimelineStore.h"
+#include "SendPipeline.h"
+#include "WorkerPool.h"
 #undef SendMessage
 
 
@@ -22,8 +30,7 @@ class MatrixClient {
 
     std::string m_nextBatch;
 
-    std::mutex m_tasksMutex;
-    std::vector<std::future<void>> m_tasks;
+    WorkerPool m_workers{ 2, 256 }; // m_sender's per-room drains
 
     static std::filesystem::path GetMatrixCredsPath() {
         wchar_t appData[MAX_PATH];
@@ -68,12 +75,55 @@ class MatrixClient {
         return std::make_pair(token, userId);
     }
 
+    // Filter ID returned by the server for a given user and filter definition
+    static std::filesystem::path GetSyncFilterPath() {
+        wchar_t appData[MAX_PATH];
+        if (SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_APPDATA, nullptr, 0, appData))) {
+            std::filesystem::path p(appData);
+            p /= L"Talkster";
+            std::filesystem::create_directories(p);
+            p /= L"sync_filter.dat";
+            return p;
+        }
+        return L"sync_filter.dat"; // fallback
+    }
+
+    static void SaveSyncFilter(const std::string& userId, const std::string& filterJson, const std::string& filterId) {
+        std::ofstream f(GetSyncFilterPath(), std::ios::trunc);
+        if (f.is_open()) f << userId << "\n" << filterJson << "\n" << filterId;
+    }
+
+    static std::optional<std::string> LoadSyncFilter(const std::string& userId, const std::string& filterJson) {
+        std::ifstream f(GetSyncFilterPath());
+        std::string savedUser, savedFilter, filterId;
+        if (!std::getline(f, savedUser) || !std::getline(f, savedFilter) || !std::getline(f, filterId)) return {};
+        if (savedUser != userId || savedFilter != filterJson || filterId.empty()) return {}; // stale
+        return filterId;
+    }
+
+    // Received messages of every room, per user, kept across sessions by m_store
+    static std::filesystem::path GetTimelineDir(const std::string& userId) {
+        wchar_t appData[MAX_PATH];
+        std::filesystem::path p;
+        if (SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_APPDATA, nullptr, 0, appData))) {
+            p = appData;
+            p /= L"Talkster";
+        }
+        p /= L"timelines";
+        p /= TimelineStore::FileName(userId);
+        return p;
+    }
+
 
 
 
 
 public:
     MatrixClient(const std::wstring& homeserver);
+    // Talk to the homeserver through transports from `makeTransport` instead of HTTPS via WinHTTP
+    // (e.g. a local mock). Two are made: one for requests, one for the /sync long poll.
+    using TransportFactory = std::function<std::unique_ptr<HttpTransport>()>;
+    MatrixClient(const std::wstring& homeserver, const TransportFactory& makeTransport);
     ~MatrixClient();
 
     using LoginCallback = std::function<void(bool)>;
@@ -89,12 +139,22 @@ public:
     std::future<bool> LoginWithSSOAndRandomRoomAsync();
 
     bool JoinRoom(const std::string& roomIdOrAlias);
+    // Make `roomId` the room the overlay follows and show its cached backlog at once. Every joined
+    // room's messages are kept while syncing, so this needs no request; false if none arrived yet.
+    bool SwitchRoom(const std::string& roomId);
     void SendMessageAsync(const std::string& roomId, const std::string& text);
 
     void Start();
     void Stop();
 
-    void SendReadReceipt(const std::string &roomId, const std::string &eventId);
+    // Must be called before Start()
+    void SetSyncPolicy(const SyncPolicy& policy) { m_syncPolicy = policy; }
+    // Any thread: cut the current long poll short and sync again at once (e.g. after joining a room)
+    void RequestSync();
+
+    // Marks `eventId` and everything before it in `roomId` read (m.read and m.fully_read) in one
+    // request. Blocking; the sync thread leaves receipts to m_receipts, which calls this.
+    bool SendReadReceipt(const std::string &roomId, const std::string &eventId);
 
     void SetOnMessage(std::function<void(const std::string& roomId, const std::string& msg)> callback) {
         m_onMessage = callback;
@@ -102,6 +162,8 @@ public:
 
     std::string m_currentRoomId;
 
+    // Field of a JSON object response by key or dotted path (nested keys only), unescaped;
+    // empty when absent or when the response is not a JSON object
     std::string ExtractJsonValue(const std::string& json, const std::string& key);
 
     std::string HttpRequest(const std::wstring& method,
@@ -109,6 +171,12 @@ public:
                             const std::string& body = "",
                             bool auth = false);
 
+    // Requests made and connections opened so far; the difference were served on kept-alive connections
+    HttpTransportStats GetHttpStats() const { return m_http->GetStats(); }
+    // Queue depth and counters of the pool behind SendMessageAsync
+    WorkerPool::Stats GetWorkerStats() const { return m_workers.GetStats(); }
+    SendPipeline::Stats GetSendStats() const { return m_sender.GetStats(); }
+
     void SetChatWindowHandle(HWND hwnd) {
         m_chatWindowHandle = hwnd;
     }
@@ -142,12 +210,60 @@ public:
         if (f.is_open()) f << roomLink;
     }
 
+    // next_batch of the last sync, next to last_room.dat, so a restart syncs incrementally
+    static std::filesystem::path GetSyncTokenPath() {
+        return GetLastRoomPath().replace_filename(L"sync_token.dat");
+    }
+
+    static void SaveSyncToken(const std::string& userId, const std::string& nextBatch) {
+        std::ofstream f(GetSyncTokenPath(), std::ios::trunc);
+        if (f.is_open()) f << userId << "\n" << nextBatch;
+    }
+
+    static std::optional<std::string> LoadSyncToken(const std::string& userId) {
+        std::ifstream f(GetSyncTokenPath());
+        std::string savedUser, nextBatch;
+        if (!std::getline(f, savedUser) || !std::getline(f, nextBatch)) return {};
+        if (savedUser != userId || nextBatch.empty()) return {}; // another account's
+        return nextBatch;
+    }
+
+    // After a login that resumed the stored session: enters the room it rejoined and shows its
+    // history. False when there is none and the user has to pick a room.
+    bool EnterResumedRoom();
+
 private:
-    void SyncLoop();
-    void SyncOnce();
+    // Stored credentials: whoami, the rejoin of the last room and an incremental sync from the
+    // stored token go out at once, and the results are kept only if whoami confirms the token
+    bool ResumeSession();
+    std::string m_resumedRoomId; // rejoined by ResumeSession(), entered by EnterResumedRoom()
 
-    HINTERNET m_hRequest = nullptr;
-    std::mutex m_httpMutex;
+    void SyncLoop();
+    bool SyncOnce();
+    std::string SyncPath(std::chrono::milliseconds timeout) const;
+    bool ProcessSync(const HttpResponse& response); // false when the scheduler should back off
+    // Writes m_nextBatch for the next launch, unless `force` is false and the last write was less
+    // than kSyncTokenSaveInterval ago
+    void SaveNextBatch(bool force);
+    static constexpr std::chrono::seconds kSyncTokenSaveInterval{ 30 };
+    std::chrono::steady_clock::time_point m_nextBatchSavedAt;
+    bool m_nextBatchUnsaved = false;
+    void PostToChat(const std::string& roomId, const std::string& body);
+
+    RoomTimelines m_timelines;
+    TimelineStore m_store; // m_timelines on disk: last session's messages are shown before any sync
+    void OpenTimelineStore();
+    void RegisterSyncFilter();
+    std::string CachedSyncFilter() const; // saved for m_userId, without a request; empty if none
+
+    std::string m_syncFilterId; // passed as filter= on every /sync once registered
+
+    std::unique_ptr<HttpTransport> m_http;
+    std::unique_ptr<HttpTransport> m_syncHttp; // dedicated so RequestSync() can cancel just the long poll
+    SyncPolicy m_syncPolicy;
+    SyncScheduler m_syncScheduler;
+    ReceiptCoalescer m_receipts; // newest shown event per room, sent off the sync thread
+    SendPipeline m_sender;       // SendMessageAsync, in order per room, on m_workers
 
     std::optional<std::string> RunLocalSSOListener();
 
@@ -164,12 +280,6 @@ private:
     std::thread m_thread;
     std::atomic<bool> m_running{ false };
 
-    template <typename F>
-    void LaunchTask(F&& func) {
-        std::lock_guard<std::mutex> lock(m_tasksMutex);
-        m_tasks.emplace_back(std::async(std::launch::async, std::forward<F>(func)));
-    }
-
 
 
 
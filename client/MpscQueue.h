@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// Lock-free multi-producer / single-consumer queue (Vyukov style, with a stub node).
+// Nodes are owned by the caller: Push() hands one in, Pop() hands one back holding the
+// popped value, so nodes can be recycled instead of reallocated per item.
+template <typename T>
+class MpscQueue {
+public:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        T value{};
+    };
+
+    MpscQueue() : m_head(new Node), m_tail(m_head.load()) {}
+
+    ~MpscQueue() {
+        Node* n = m_tail;
+        while (n) {
+            Node* next = n->next.load(std::memory_order_relaxed);
+            delete n;
+            n = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Any thread
+    void Push(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer thread only. Returns nullptr when empty (or when a producer is mid-push).
+    // The returned node is detached from the queue and carries the popped value.
+    Node* Pop() {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return nullptr;
+
+        // `next` becomes the new stub; its value moves into the old stub we give back
+        m_tail = next;
+        std::swap(tail->value, next->value);
+        return tail;
+    }
+
+private:
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+};
@@ -0,0 +1,83 @@
+#include "ReceiptCoalescer.h"
+#include <algorithm>
+
+ReceiptCoalescer::ReceiptCoalescer(Sender send, std::chrono::milliseconds delay)
+    : m_send(std::move(send)), m_delay(delay) {}
+
+ReceiptCoalescer::~ReceiptCoalescer() {
+    Stop();
+}
+
+void ReceiptCoalescer::Start() {
+    if (m_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = false;
+    }
+    m_thread = std::thread(&ReceiptCoalescer::Run, this);
+}
+
+void ReceiptCoalescer::Stop() {
+    if (!m_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void ReceiptCoalescer::Mark(std::string_view roomId, std::string_view eventId) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.marked++;
+        auto it = std::find_if(m_pending.begin(), m_pending.end(), [&](const Pending& p) { return p.roomId == roomId; });
+        if (it != m_pending.end()) {
+            it->eventId.assign(eventId); // supersedes the older one
+            it->attempts = 0;
+            return;
+        }
+        m_pending.push_back({ std::string(roomId), std::string(eventId) });
+    }
+    m_cv.notify_all();
+}
+
+ReceiptCoalescer::Stats ReceiptCoalescer::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void ReceiptCoalescer::Run() {
+    std::vector<Pending> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+        // Let the rest of a burst land; Stop() cuts the wait short and flushes
+        m_cv.wait_for(lock, m_delay, [this] { return m_stop; });
+
+        batch.swap(m_pending);
+        bool last = m_stop;
+        lock.unlock();
+        SendBatch(batch);
+        lock.lock();
+
+        if (last) return;
+    }
+}
+
+void ReceiptCoalescer::SendBatch(std::vector<Pending>& batch) {
+    for (auto& p : batch) {
+        bool ok = m_send(p.roomId, p.eventId);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (ok) {
+            m_stats.sent++;
+            continue;
+        }
+        m_stats.failed++;
+        // Retry unless a newer receipt for the room arrived meanwhile or it keeps failing
+        bool superseded = std::any_of(m_pending.begin(), m_pending.end(), [&](const Pending& q) { return q.roomId == p.roomId; });
+        if (!superseded && ++p.attempts < kMaxAttempts) m_pending.push_back(std::move(p));
+    }
+    batch.clear();
+}
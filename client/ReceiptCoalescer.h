@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Collects read receipts and sends them from its own thread. Only the newest event per room is
+// kept, and sending waits `delay` after the first mark so a burst of messages costs one request
+// per room. Mark() never touches the network, so the sync thread never waits on receipts.
+class ReceiptCoalescer {
+public:
+    // Sends one receipt; false to retry it in the next round
+    using Sender = std::function<bool(const std::string& roomId, const std::string& eventId)>;
+
+    struct Stats {
+        uint64_t marked = 0;
+        uint64_t sent = 0;
+        uint64_t failed = 0;
+    };
+
+    explicit ReceiptCoalescer(Sender send, std::chrono::milliseconds delay = std::chrono::milliseconds(1000));
+    ~ReceiptCoalescer();
+
+    ReceiptCoalescer(const ReceiptCoalescer&) = delete;
+    ReceiptCoalescer& operator=(const ReceiptCoalescer&) = delete;
+
+    void Start();
+    // Sends whatever is still pending once, then joins the thread
+    void Stop();
+
+    // Any thread: `eventId` is the newest event read in `roomId`. Later events must be marked later.
+    void Mark(std::string_view roomId, std::string_view eventId);
+
+    Stats GetStats() const;
+
+private:
+    struct Pending {
+        std::string roomId;
+        std::string eventId;
+        unsigned attempts = 0;
+    };
+
+    void Run();
+    void SendBatch(std::vector<Pending>& batch);
+
+    static constexpr unsigned kMaxAttempts = 3;
+
+    Sender m_send;
+    std::chrono::milliseconds m_delay;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Pending> m_pending; // at most one entry per room
+    bool m_stop = false;
+    Stats m_stats;
+    std::thread m_thread;
+};
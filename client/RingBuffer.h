@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Fixed-capacity FIFO that overwrites its oldest element when full. Storage is allocated on the
+// first Push() and never grows, so an idle buffer costs nothing and a busy one never reallocates.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+    void Push(T value) {
+        if (m_items.size() < m_capacity) {
+            if (m_items.empty()) m_items.reserve(m_capacity);
+            m_items.push_back(std::move(value));
+            return;
+        }
+        m_items[m_head] = std::move(value);
+        m_head = (m_head + 1) % m_capacity;
+    }
+
+    size_t Size() const { return m_items.size(); }
+    size_t Capacity() const { return m_capacity; }
+    bool Empty() const { return m_items.empty(); }
+
+    // 0 is the oldest element
+    const T& operator[](size_t i) const { return m_items[(m_head + i) % m_items.size()]; }
+    const T& Newest() const { return (*this)[m_items.size() - 1]; }
+
+    template <typename F>
+    void ForEach(F&& f) const {
+        for (size_t i = 0; i < m_items.size(); ++i) f((*this)[i]);
+    }
+
+private:
+    size_t m_capacity;
+    size_t m_head = 0;     // index of the oldest element once full
+    std::vector<T> m_items;
+};
@@ -0,0 +1,36 @@
+#include "RoomTimelines.h"
+
+bool RoomTimelines::Append(std::string_view roomId, RoomMessage message) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rooms.Emplace(roomId, m_capacity).Push(std::move(message));
+    return roomId == m_active;
+}
+
+bool RoomTimelines::SetActive(std::string_view roomId, const std::function<void(const RoomMessage&)>& replay) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active.assign(roomId);
+    const auto* ring = m_rooms.Find(roomId);
+    if (!ring) return false;
+    if (replay) ring->ForEach(replay);
+    return true;
+}
+
+std::string RoomTimelines::ActiveRoom() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_active;
+}
+
+size_t RoomTimelines::RoomCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rooms.Size();
+}
+
+std::vector<RoomMessage> RoomTimelines::Backlog(std::string_view roomId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<RoomMessage> out;
+    if (const auto* ring = m_rooms.Find(roomId)) {
+        out.reserve(ring->Size());
+        ring->ForEach([&](const RoomMessage& m) { out.push_back(m); });
+    }
+    return out;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "FlatStringMap.h"
+#include "RingBuffer.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct RoomMessage {
+    std::string eventId;
+    std::string sender;
+    std::string body;
+    uint64_t originServerTs = 0;
+};
+
+// The latest messages of every joined room, one fixed-size ring per room, found by room ID
+// through a flat hash map. One room is active: switching to another replays its cached backlog
+// with no network round-trip. Thread-safe; the sync thread appends while the UI switches rooms.
+class RoomTimelines {
+public:
+    explicit RoomTimelines(size_t perRoomCapacity = 64) : m_capacity(perRoomCapacity) {}
+
+    // Stores `message` and returns true if `roomId` is the active room, so the caller should show
+    // it now. Serialized with SetActive(): a message is either in the replayed backlog or reported
+    // here, never both or neither.
+    bool Append(std::string_view roomId, RoomMessage message);
+
+    // Makes `roomId` active and calls `replay` for each cached message, oldest first, while
+    // Append() is held off. Returns false if nothing has been seen for the room yet.
+    bool SetActive(std::string_view roomId, const std::function<void(const RoomMessage&)>& replay);
+
+    std::string ActiveRoom() const;
+    size_t Capacity() const { return m_capacity; } // messages kept per room
+    size_t RoomCount() const;
+    std::vector<RoomMessage> Backlog(std::string_view roomId) const; // oldest first
+
+private:
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    FlatStringMap<RingBuffer<RoomMessage>> m_rooms;
+    std::string m_active;
+};
@@ -0,0 +1,145 @@
+#include "SendPipeline.h"
+#include "ChaCha20Rng.h"
+#include <algorithm>
+#include <charconv>
+
+// 429 bodies carry {"errcode":"M_LIMIT_EXCEEDED","retry_after_ms":N}
+static std::chrono::milliseconds RetryAfter(const std::string& body) {
+    static constexpr std::string_view key = "\"retry_after_ms\":";
+    size_t pos = body.find(key);
+    if (pos == std::string::npos) return {};
+    pos += key.size();
+    while (pos < body.size() && body[pos] == ' ') pos++;
+    long long ms = 0;
+    std::from_chars(body.data() + pos, body.data() + body.size(), ms);
+    return std::chrono::milliseconds(std::max(ms, 0LL));
+}
+
+SendPipeline::SendPipeline(HttpTransport& http, WorkerPool& workers, size_t window, size_t maxQueuedPerRoom)
+    : m_http(http), m_workers(workers), m_window(std::max<size_t>(window, 1)), m_maxQueued(maxQueuedPerRoom) {
+    // Unique per session, so counters from an earlier run can never collide with this one's
+    uint8_t bytes[8];
+    if (!ChaCha20Rng::OsRandom(bytes, sizeof(bytes))) {
+        auto now = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+        std::copy_n(reinterpret_cast<const uint8_t*>(&now), sizeof(bytes), bytes);
+    }
+    static constexpr char hex[] = "0123456789abcdef";
+    for (uint8_t b : bytes) {
+        m_txnPrefix.push_back(hex[b >> 4]);
+        m_txnPrefix.push_back(hex[b & 15]);
+    }
+    m_txnPrefix.push_back('.');
+}
+
+SendPipeline::~SendPipeline() {
+    Stop();
+}
+
+void SendPipeline::SetAccessToken(std::string token) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_token = std::move(token);
+}
+
+std::string SendPipeline::Send(const std::string& roomId, std::string content) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RoomQueue& room = m_rooms.Emplace(roomId);
+    if (m_stopped || room.pending.size() >= m_maxQueued) return {};
+
+    // Submitted under m_mutex so a refused drain cannot strand a message another Send() queued
+    if (!room.draining) {
+        if (!m_workers.Submit([this, roomId] { Drain(roomId); })) return {};
+        room.draining = true;
+    }
+
+    std::string txnId = m_txnPrefix + std::to_string(++m_txnCounter);
+    room.pending.push_back({ txnId, std::move(content) });
+    m_stats.queued++;
+    return txnId;
+}
+
+void SendPipeline::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_cv.notify_all();
+}
+
+void SendPipeline::Start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = false;
+}
+
+SendPipeline::Stats SendPipeline::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void SendPipeline::WaitBeforeRetry(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait_for(lock, delay, [this] { return m_stopped; });
+}
+
+void SendPipeline::Drain(const std::string& roomId) {
+    const std::string path = "/_matrix/client/r0/rooms/" + roomId + "/send/m.room.message/";
+    std::vector<Outgoing> batch;
+    std::vector<std::string> targets;
+    std::vector<HttpRequestSpec> requests;
+    std::string token;
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            RoomQueue& room = *m_rooms.Find(roomId);
+            if (room.pending.empty()) {
+                room.draining = false;
+                return;
+            }
+            // Copies: the originals stay queued until their responses confirm them
+            size_t n = std::min(room.pending.size(), m_window);
+            batch.assign(room.pending.begin(), room.pending.begin() + n);
+            token = m_token;
+            m_stats.batches++;
+        }
+
+        targets.clear();
+        requests.clear();
+        for (const auto& msg : batch) targets.push_back(path + msg.txnId);
+        for (size_t i = 0; i < batch.size(); ++i) requests.push_back({ "PUT", targets[i], batch[i].content, token });
+        auto responses = m_http.RequestPipelined(requests);
+
+        // Confirm in order up to the first failure; whatever follows it is sent again next round
+        // under the same transaction IDs, so ones the server already took are not duplicated
+        std::chrono::milliseconds backoff{ 0 };
+        std::string failedTxn;
+        int failedStatus = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            RoomQueue& room = *m_rooms.Find(roomId);
+            for (const auto& response : responses) {
+                Outgoing& msg = room.pending.front();
+                if (response.status >= 200 && response.status < 300) {
+                    room.pending.pop_front();
+                    m_stats.sent++;
+                    continue;
+                }
+
+                bool transient = response.status == 0 || response.status == 429 || response.status >= 500;
+                if (transient && !m_stopped && ++msg.attempts < kMaxAttempts) {
+                    m_stats.retried++;
+                    backoff = std::min(kInitialBackoff * (1u << (msg.attempts - 1)), kMaxBackoff);
+                    if (response.status == 429) backoff = std::max(backoff, RetryAfter(response.body));
+                } else {
+                    failedTxn = std::move(msg.txnId);
+                    failedStatus = response.status;
+                    room.pending.pop_front();
+                    m_stats.failed++;
+                }
+                break;
+            }
+        }
+
+        if (!failedTxn.empty() && m_onFailure) m_onFailure(roomId, failedTxn, failedStatus);
+        if (backoff.count() > 0) WaitBeforeRetry(backoff); // cut short by Stop(); then one last try
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "FlatStringMap.h"
+#include "HttpTransport.h"
+#include "WorkerPool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Outgoing m.room.message events, delivered in order per room. Each room has a FIFO drained by at
+// most one WorkerPool task at a time; the drain sends up to `window` queued messages pipelined
+// (HttpTransport::RequestPipelined), so later messages are in flight while the first response is
+// pending. Transaction IDs are a random per-session prefix plus a counter, never reused, so a
+// retry after a lost response is deduplicated by the server instead of posting twice.
+//
+// A message that fails transiently (no response, 429, 5xx) is retried, together with everything
+// queued behind it, after a backoff. With a pipelining transport one reordering remains possible:
+// the server fails one message of a window with 429/5xx but accepts a later one, and the failed
+// one lands after it on retry. Transports that send one by one stop at the failure instead.
+class SendPipeline {
+public:
+    // Pool thread: a message was given up on; `status` is the last HTTP status (0: no response)
+    using FailureCallback = std::function<void(const std::string& roomId, const std::string& txnId, int status)>;
+
+    struct Stats {
+        uint64_t queued = 0;
+        uint64_t sent = 0;
+        uint64_t retried = 0;
+        uint64_t failed = 0;
+        uint64_t batches = 0; // RequestPipelined calls
+    };
+
+    SendPipeline(HttpTransport& http, WorkerPool& workers, size_t window = 8, size_t maxQueuedPerRoom = 256);
+    ~SendPipeline();
+
+    SendPipeline(const SendPipeline&) = delete;
+    SendPipeline& operator=(const SendPipeline&) = delete;
+
+    void SetAccessToken(std::string token);
+    void SetOnFailure(FailureCallback cb) { m_onFailure = std::move(cb); } // before the first Send()
+
+    // Any thread. Queues `content` (the event JSON) for `roomId` and returns its transaction ID;
+    // empty when the room's queue is full or the pipeline is stopped.
+    std::string Send(const std::string& roomId, std::string content);
+
+    // Sends after Stop() are refused; queued messages still get one attempt each, without retries.
+    // The WorkerPool's own Stop() then waits for the drains.
+    void Stop();
+    void Start();
+
+    Stats GetStats() const;
+
+private:
+    struct Outgoing {
+        std::string txnId;
+        std::string content;
+        unsigned attempts = 0;
+    };
+
+    struct RoomQueue {
+        std::deque<Outgoing> pending; // front is the next to be confirmed
+        bool draining = false;        // a pool task owns the queue
+    };
+
+    void Drain(const std::string& roomId);
+    void WaitBeforeRetry(std::chrono::milliseconds delay); // cut short by Stop()
+
+    static constexpr unsigned kMaxAttempts = 5;
+    static constexpr std::chrono::milliseconds kInitialBackoff{ 500 };
+    static constexpr std::chrono::milliseconds kMaxBackoff{ 8000 };
+
+    HttpTransport& m_http;
+    WorkerPool& m_workers;
+    size_t m_window;
+    size_t m_maxQueued;
+    FailureCallback m_onFailure;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    FlatStringMap<RoomQueue> m_rooms;
+    std::string m_token;
+    std::string m_txnPrefix;
+    uint64_t m_txnCounter = 0;
+    bool m_stopped = false;
+    Stats m_stats;
+};
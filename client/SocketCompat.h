@@ -0,0 +1,154 @@
+#pragma once
+// Thin layer over Winsock / BSD sockets so the networking core builds on both.
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "Ws2_32.lib")
+
+using IoBuf = WSABUF;
+using PollFd = WSAPOLLFD;
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+using SOCKET = int;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+#ifndef SD_BOTH
+#define SD_BOTH SHUT_RDWR
+#endif
+inline int closesocket(SOCKET s) { return ::close(s); }
+
+using IoBuf = iovec;
+using PollFd = pollfd;
+#endif
+
+namespace Net {
+
+// Initialises Winsock once per process; later calls return the first result. It is never torn
+// down: the OS reclaims it at exit, and per-connection WSAStartup/WSACleanup pairs only cost time.
+inline bool Startup() {
+#ifdef _WIN32
+    static const bool ok = [] {
+        WSADATA wsa;
+        return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    }();
+    return ok;
+#else
+    return true;
+#endif
+}
+
+inline int LastError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+inline bool WouldBlock(int err) {
+#ifdef _WIN32
+    return err == WSAEWOULDBLOCK;
+#else
+    return err == EWOULDBLOCK || err == EAGAIN;
+#endif
+}
+
+// A non-blocking connect() that has started and will finish later
+inline bool ConnectInProgress(int err) {
+#ifdef _WIN32
+    return err == WSAEWOULDBLOCK;
+#else
+    return err == EINPROGRESS;
+#endif
+}
+
+// Pending error of a socket (SO_ERROR), e.g. the outcome of a non-blocking connect()
+inline int SocketError(SOCKET s) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len) != 0) return LastError();
+    return err;
+}
+
+inline int Poll(PollFd* fds, size_t count, int timeoutMs) {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+#else
+    return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+#endif
+}
+
+inline bool SetNonBlocking(SOCKET s, bool on) {
+#ifdef _WIN32
+    u_long mode = on ? 1 : 0;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags < 0) return false;
+    flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(s, F_SETFL, flags) == 0;
+#endif
+}
+
+inline void SetIoBuf(IoBuf& b, void* data, size_t len) {
+#ifdef _WIN32
+    b.buf = static_cast<CHAR*>(data);
+    b.len = static_cast<ULONG>(len);
+#else
+    b.iov_base = data;
+    b.iov_len = len;
+#endif
+}
+
+inline size_t IoBufLen(const IoBuf& b) {
+#ifdef _WIN32
+    return b.len;
+#else
+    return b.iov_len;
+#endif
+}
+
+inline void AdvanceIoBuf(IoBuf& b, size_t n) {
+#ifdef _WIN32
+    b.buf += n;
+    b.len -= static_cast<ULONG>(n);
+#else
+    b.iov_base = static_cast<char*>(b.iov_base) + n;
+    b.iov_len -= n;
+#endif
+}
+
+// One vectored write (WSASend / sendmsg). Returns the bytes written, or -1 with the
+// reason in LastError(). Never raises SIGPIPE.
+inline long long SendV(SOCKET s, IoBuf* bufs, size_t count) {
+#ifdef _WIN32
+    DWORD sent = 0;
+    if (WSASend(s, bufs, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) == SOCKET_ERROR) return -1;
+    return sent;
+#else
+    msghdr msg{};
+    msg.msg_iov = bufs;
+    msg.msg_iovlen = count;
+    ssize_t sent = ::sendmsg(s, &msg, MSG_NOSIGNAL);
+    return sent < 0 ? -1 : sent;
+#endif
+}
+
+} // namespace Net
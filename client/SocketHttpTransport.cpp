@@ -0,0 +1,362 @@
+#include "SocketHttpTransport.h"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <optional>
+
+static bool EqualsNoCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return (x | 0x20) == (y | 0x20); // ASCII only; header names and tokens are ASCII
+    });
+}
+
+static std::string_view Trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+// ----------------- Response reader -----------------
+// Buffers bytes from a non-blocking socket, waiting (deadline / cancel aware) when it runs dry
+class ResponseReader {
+public:
+    ResponseReader(SOCKET s, const TcpConnectOptions& options, size_t maxLine)
+        : m_socket(s), m_options(options), m_maxLine(maxLine) {}
+
+    bool ReadLine(std::string_view& line) {
+        for (;;) {
+            size_t end = m_buf.find("\r\n", m_pos);
+            if (end != std::string::npos) {
+                line = std::string_view(m_buf).substr(m_pos, end - m_pos);
+                m_pos = end + 2;
+                return true;
+            }
+            if (m_buf.size() - m_pos > m_maxLine || !Fill()) return false;
+        }
+    }
+
+    bool ReadExact(size_t n, std::string& out) {
+        Compact();
+        while (m_buf.size() - m_pos < n) {
+            if (!Fill(n - (m_buf.size() - m_pos))) return false;
+        }
+        out.append(m_buf, m_pos, n);
+        m_pos += n;
+        return true;
+    }
+
+    void ReadToEnd(std::string& out, size_t limit) {
+        while (m_buf.size() - m_pos <= limit && Fill()) {}
+        out.append(m_buf, m_pos, std::min(limit, m_buf.size() - m_pos));
+        m_pos = m_buf.size();
+    }
+
+    bool Received() const { return !m_buf.empty(); }
+    bool Drained() const { return m_pos == m_buf.size(); } // nothing beyond the response arrived
+
+private:
+    bool Fill(size_t want = 0) {
+        size_t chunk = std::clamp<size_t>(want, 16 * 1024, 1024 * 1024);
+        for (;;) {
+            size_t old = m_buf.size();
+            m_buf.resize(old + chunk);
+            int n = recv(m_socket, m_buf.data() + old, static_cast<int>(chunk), 0);
+            m_buf.resize(old + std::max(n, 0));
+            if (n > 0) return true;
+            if (n == 0 || !Net::WouldBlock(Net::LastError())) return false;
+            if (!WaitSocket(m_socket, false, m_options)) return false;
+        }
+    }
+
+    // Drops consumed header lines so a large body is not appended behind them
+    void Compact() {
+        if (m_pos == 0) return;
+        m_buf.erase(0, m_pos);
+        m_pos = 0;
+    }
+
+    SOCKET m_socket;
+    const TcpConnectOptions& m_options;
+    size_t m_maxLine;
+    std::string m_buf;
+    size_t m_pos = 0;
+};
+
+static bool SendAll(SOCKET s, std::string_view head, std::string_view body, const TcpConnectOptions& options) {
+    IoBuf bufs[2];
+    Net::SetIoBuf(bufs[0], const_cast<char*>(head.data()), head.size());
+    Net::SetIoBuf(bufs[1], const_cast<char*>(body.data()), body.size());
+    IoBuf* first = bufs;
+    size_t count = body.empty() ? 1 : 2;
+
+    while (count) {
+        long long n = Net::SendV(s, first, count);
+        if (n < 0) {
+            if (Net::WouldBlock(Net::LastError()) && WaitSocket(s, true, options)) continue;
+            return false;
+        }
+        auto left = static_cast<size_t>(n);
+        while (count && left >= Net::IoBufLen(*first)) {
+            left -= Net::IoBufLen(*first);
+            ++first;
+            --count;
+        }
+        if (count) Net::AdvanceIoBuf(*first, left);
+    }
+    return true;
+}
+
+// ----------------- SocketHttpTransport -----------------
+SocketHttpTransport::SocketHttpTransport(const std::string& host, uint16_t port, size_t maxIdle)
+    : m_host(host), m_port(port), m_maxIdle(maxIdle) {
+    Net::Startup();
+    m_hostHeader = host.find(':') != std::string::npos ? "[" + host + "]" : host; // IPv6 literal
+    if (port != 80) m_hostHeader += ":" + std::to_string(port);
+}
+
+SocketHttpTransport::~SocketHttpTransport() {
+    CancelAll();
+}
+
+HttpTransportStats SocketHttpTransport::GetStats() const {
+    return { m_requests.load(), m_connectionsOpened.load() };
+}
+
+void SocketHttpTransport::CancelAll() {
+    std::vector<SOCKET> idle;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto* cancel : m_inflight) cancel->store(true);
+        idle.swap(m_idle);
+    }
+    for (SOCKET s : idle) closesocket(s);
+}
+
+SOCKET SocketHttpTransport::TakeIdle() {
+    for (;;) {
+        SOCKET s;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_idle.empty()) return INVALID_SOCKET;
+            s = m_idle.back();
+            m_idle.pop_back();
+        }
+        // An idle keep-alive connection has nothing to read; readable means the server closed it
+        PollFd fd{ s, POLLIN, 0 };
+        if (Net::Poll(&fd, 1, 0) == 0) return s;
+        closesocket(s);
+    }
+}
+
+void SocketHttpTransport::ParkIdle(SOCKET s) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_idle.size() < m_maxIdle) {
+            m_idle.push_back(s);
+            return;
+        }
+    }
+    closesocket(s);
+}
+
+std::string SocketHttpTransport::BuildHead(std::string_view method, std::string_view target, std::string_view body,
+                                           std::string_view bearerToken) const {
+    std::string head;
+    head.reserve(256 + target.size() + bearerToken.size());
+    head.append(method).append(" ").append(target).append(" HTTP/1.1\r\nHost: ").append(m_hostHeader);
+    head.append("\r\nUser-Agent: MatrixClient/1.0\r\nAccept: application/json\r\n");
+    if (!bearerToken.empty()) head.append("Authorization: Bearer ").append(bearerToken).append("\r\n");
+    if (!body.empty()) head.append("Content-Type: application/json\r\n");
+    if (!body.empty() || (method != "GET" && method != "HEAD"))
+        head.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n");
+    if (!m_keepAlive) head.append("Connection: close\r\n");
+    head.append("\r\n");
+    return head;
+}
+
+SOCKET SocketHttpTransport::Connect(const TcpConnectOptions& options) {
+    std::string error;
+    SOCKET s = TcpConnect(m_host, m_port, options, error);
+    if (s == INVALID_SOCKET) return s;
+    m_connectionsOpened++;
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+    return s;
+}
+
+HttpResponse SocketHttpTransport::Request(std::string_view method, std::string_view target,
+                                          std::string_view body, std::string_view bearerToken) {
+    m_requests++;
+    std::string head = BuildHead(method, target, body, bearerToken);
+
+    std::atomic<bool> cancel{ false };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inflight.push_back(&cancel);
+    }
+
+    TcpConnectOptions options;
+    options.deadline = std::chrono::steady_clock::now() + m_timeout;
+    options.cancel = &cancel;
+
+    HttpResponse response;
+    // A parked connection can still die in the window between the liveness check and the write;
+    // the request then goes out once more on a fresh connection.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        SOCKET s = m_keepAlive ? TakeIdle() : INVALID_SOCKET;
+        bool reused = s != INVALID_SOCKET;
+        if (!reused) {
+            s = Connect(options);
+            if (s == INVALID_SOCKET) break;
+        }
+
+        response = {};
+        Outcome outcome = Exchange(s, head, body, method == "HEAD", options, response);
+        if (outcome == Outcome::Reusable && m_keepAlive) ParkIdle(s);
+        else closesocket(s);
+
+        if (outcome == Outcome::Stale && reused && !cancel) continue;
+        if (outcome == Outcome::Failed || outcome == Outcome::Stale) response = {};
+        break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inflight.erase(std::find(m_inflight.begin(), m_inflight.end(), &cancel));
+    }
+    return response;
+}
+
+std::vector<HttpResponse> SocketHttpTransport::RequestPipelined(const std::vector<HttpRequestSpec>& requests) {
+    if (requests.size() < 2 || !m_keepAlive) return HttpTransport::RequestPipelined(requests);
+    m_requests += requests.size();
+
+    // The whole batch goes out in one write; the deadline covers all of it
+    std::string wire;
+    for (const auto& r : requests) wire.append(BuildHead(r.method, r.target, r.body, r.bearerToken)).append(r.body);
+
+    std::atomic<bool> cancel{ false };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inflight.push_back(&cancel);
+    }
+
+    TcpConnectOptions options;
+    options.deadline = std::chrono::steady_clock::now() + m_timeout;
+    options.cancel = &cancel;
+
+    std::vector<HttpResponse> responses(requests.size());
+    size_t done = 0;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        SOCKET s = TakeIdle();
+        bool reused = s != INVALID_SOCKET;
+        if (!reused) {
+            s = Connect(options);
+            if (s == INVALID_SOCKET) break;
+        }
+
+        Outcome outcome = Outcome::Stale;
+        if (SendAll(s, wire, {}, options)) {
+            ResponseReader reader(s, options, kMaxHeaderSize);
+            while (done < requests.size()) {
+                outcome = ReadResponse(reader, requests[done].method == "HEAD", responses[done]);
+                if (outcome == Outcome::Failed || outcome == Outcome::Stale) break;
+                ++done;
+                if (outcome == Outcome::Ok) break; // the server closes after this one
+            }
+            if (outcome == Outcome::Reusable && !reader.Drained()) outcome = Outcome::Ok;
+        }
+        if (outcome == Outcome::Reusable) ParkIdle(s);
+        else closesocket(s);
+
+        // Nothing came back on a reused connection: it was dead before the write, so nothing ran
+        if (outcome == Outcome::Stale && reused && done == 0 && !cancel) continue;
+        break;
+    }
+    for (size_t i = done; i < responses.size(); ++i) responses[i] = {};
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inflight.erase(std::find(m_inflight.begin(), m_inflight.end(), &cancel));
+    }
+    return responses;
+}
+
+SocketHttpTransport::Outcome SocketHttpTransport::Exchange(SOCKET s, std::string_view head, std::string_view body,
+                                                           bool headOnly, const TcpConnectOptions& options,
+                                                           HttpResponse& out) {
+    if (!SendAll(s, head, body, options)) return Outcome::Stale;
+
+    ResponseReader reader(s, options, kMaxHeaderSize);
+    Outcome outcome = ReadResponse(reader, headOnly, out);
+    // Anything beyond the response means the connection is out of step
+    return outcome == Outcome::Reusable && !reader.Drained() ? Outcome::Ok : outcome;
+}
+
+SocketHttpTransport::Outcome SocketHttpTransport::ReadResponse(ResponseReader& reader, bool headOnly, HttpResponse& out) {
+    std::string_view line;
+    bool interim = true;
+    bool http11 = false;
+    while (interim) {
+        if (!reader.ReadLine(line)) return reader.Received() ? Outcome::Failed : Outcome::Stale;
+        // "HTTP/1.1 200 OK"
+        if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." || line[8] != ' ') return Outcome::Failed;
+        http11 = line[7] == '1';
+        auto [end, ec] = std::from_chars(line.data() + 9, line.data() + 12, out.status);
+        if (ec != std::errc() || end != line.data() + 12) return Outcome::Failed;
+        interim = out.status >= 100 && out.status < 200; // 100 Continue etc. precede the real response
+        if (interim) {
+            do { if (!reader.ReadLine(line)) return Outcome::Failed; } while (!line.empty());
+        }
+    }
+
+    bool keepAlive = http11;
+    bool chunked = false;
+    std::optional<size_t> contentLength;
+    size_t headerBytes = 0;
+    for (;;) {
+        if (!reader.ReadLine(line)) return Outcome::Failed;
+        if (line.empty()) break;
+        headerBytes += line.size();
+        if (headerBytes > kMaxHeaderSize) return Outcome::Failed;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) continue;
+        auto name = Trim(line.substr(0, colon));
+        auto value = Trim(line.substr(colon + 1));
+        if (EqualsNoCase(name, "Content-Length")) {
+            size_t n = 0;
+            auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+            if (ec != std::errc() || end != value.data() + value.size()) return Outcome::Failed;
+            contentLength = n;
+        } else if (EqualsNoCase(name, "Transfer-Encoding")) {
+            chunked = value.size() >= 7 && EqualsNoCase(value.substr(value.size() - 7), "chunked");
+        } else if (EqualsNoCase(name, "Connection")) {
+            if (EqualsNoCase(value, "close")) keepAlive = false;
+            else if (EqualsNoCase(value, "keep-alive")) keepAlive = true;
+        }
+    }
+
+    if (headOnly || out.status == 204 || out.status == 304) {
+        // no body
+    } else if (chunked) {
+        for (;;) {
+            if (!reader.ReadLine(line)) return Outcome::Failed;
+            size_t size = 0;
+            auto [end, ec] = std::from_chars(line.data(), line.data() + line.size(), size, 16);
+            if (ec != std::errc() || size > kMaxBodySize - out.body.size()) return Outcome::Failed;
+            if (size == 0) break;
+            if (!reader.ReadExact(size, out.body) || !reader.ReadLine(line) || !line.empty()) return Outcome::Failed;
+        }
+        do { if (!reader.ReadLine(line)) return Outcome::Failed; } while (!line.empty()); // trailers
+    } else if (contentLength) {
+        if (*contentLength > kMaxBodySize) return Outcome::Failed;
+        out.body.reserve(*contentLength);
+        if (!reader.ReadExact(*contentLength, out.body)) return Outcome::Failed;
+    } else {
+        reader.ReadToEnd(out.body, kMaxBodySize); // delimited by the server closing
+        return Outcome::Ok;
+    }
+
+    return keepAlive ? Outcome::Reusable : Outcome::Ok;
+}
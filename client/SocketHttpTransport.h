@@ -0,0 +1,64 @@
+#pragma once
+#include "HttpTransport.h"
+#include "SocketCompat.h"
+#include "TcpConnect.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+class ResponseReader;
+
+// HttpTransport over plain TCP (no TLS), for local servers such as a mock homeserver in tests.
+// Up to maxIdle keep-alive connections are parked after a response and handed to later requests;
+// a parked connection the server has since closed is noticed and replaced before it is used.
+// RequestPipelined() writes a whole batch on one connection before reading the responses.
+class SocketHttpTransport : public HttpTransport {
+public:
+    SocketHttpTransport(const std::string& host, uint16_t port, size_t maxIdle = 4);
+    ~SocketHttpTransport() override;
+
+    SocketHttpTransport(const SocketHttpTransport&) = delete;
+    SocketHttpTransport& operator=(const SocketHttpTransport&) = delete;
+
+    HttpResponse Request(std::string_view method, std::string_view target,
+                         std::string_view body, std::string_view bearerToken = {}) override;
+    std::vector<HttpResponse> RequestPipelined(const std::vector<HttpRequestSpec>& requests) override;
+    void CancelAll() override;
+    HttpTransportStats GetStats() const override;
+
+    // Deadline for one request: connect, write and the whole response
+    void SetTimeout(std::chrono::milliseconds timeout) override { m_timeout = timeout; }
+    // Off: every request dials a new connection and sends "Connection: close"
+    void SetKeepAlive(bool on) { m_keepAlive = on; }
+
+private:
+    enum class Outcome { Ok, Reusable, Stale, Failed };
+
+    std::string BuildHead(std::string_view method, std::string_view target, std::string_view body,
+                          std::string_view bearerToken) const;
+    SOCKET Connect(const TcpConnectOptions& options);
+    Outcome Exchange(SOCKET s, std::string_view head, std::string_view body, bool headOnly,
+                     const TcpConnectOptions& options, HttpResponse& out);
+    // One response off `reader`; Reusable when the server keeps the connection open after it
+    static Outcome ReadResponse(ResponseReader& reader, bool headOnly, HttpResponse& out);
+    SOCKET TakeIdle();
+    void ParkIdle(SOCKET s);
+
+    static constexpr size_t kMaxHeaderSize = 64 * 1024;
+    static constexpr size_t kMaxBodySize = 64 * 1024 * 1024;
+
+    std::string m_host;
+    std::string m_hostHeader;
+    uint16_t m_port;
+    size_t m_maxIdle;
+    std::chrono::milliseconds m_timeout{ 30000 };
+    bool m_keepAlive = true;
+
+    mutable std::mutex m_mutex;
+    std::vector<SOCKET> m_idle;                  // most recently used last
+    std::vector<std::atomic<bool>*> m_inflight;  // cancel flags of running requests
+
+    std::atomic<uint64_t> m_requests{ 0 };
+    std::atomic<uint64_t> m_connectionsOpened{ 0 };
+};
@@ -0,0 +1,126 @@
+#include "SyncParser.h"
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+// Where the parser is inside the response. Anything not listed is skipped by depth counting.
+enum class Scope { Root, Rooms, Join, Room, Timeline, Events, Event, Content };
+
+class SyncSax {
+public:
+    SyncSax(const std::function<bool(std::string_view)>& wantRoom, SyncBatch& out)
+        : m_wantRoom(wantRoom), m_out(out) {}
+
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(json::number_integer_t value) {
+        return value < 0 || number_unsigned(static_cast<json::number_unsigned_t>(value));
+    }
+    bool number_unsigned(json::number_unsigned_t value) {
+        if (InEvent() && m_key == "origin_server_ts") m_out.events.back().originServerTs = value;
+        return true;
+    }
+    bool number_float(json::number_float_t, const json::string_t&) { return true; }
+    bool binary(json::binary_t&) { return true; }
+
+    bool string(json::string_t& value) {
+        if (m_skip || m_scopes.empty()) return true;
+        switch (m_scopes.back()) {
+            case Scope::Root:
+                if (m_key == "next_batch") m_out.nextBatch = std::move(value);
+                break;
+            case Scope::Event: {
+                auto& ev = m_out.events.back();
+                if (m_key == "type") ev.type = std::move(value);
+                else if (m_key == "sender") ev.sender = std::move(value);
+                else if (m_key == "event_id") ev.eventId = std::move(value);
+                break;
+            }
+            case Scope::Content: {
+                auto& ev = m_out.events.back();
+                if (m_key == "msgtype") ev.msgtype = std::move(value);
+                else if (m_key == "body") ev.body = std::move(value);
+                break;
+            }
+            default:
+                break;
+        }
+        return true;
+    }
+
+    bool key(json::string_t& value) {
+        if (!m_skip) m_key.swap(value);
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        if (m_skip) { ++m_skip; return true; }
+        if (m_scopes.empty()) { m_scopes.push_back(Scope::Root); return true; }
+
+        switch (m_scopes.back()) {
+            case Scope::Root:
+                return Enter(m_key == "rooms", Scope::Rooms);
+            case Scope::Rooms:
+                return Enter(m_key == "join", Scope::Join);
+            case Scope::Join:
+                if (!m_wantRoom(m_key)) return Enter(false, Scope::Room);
+                m_roomId = m_key;
+                return Enter(true, Scope::Room);
+            case Scope::Room:
+                return Enter(m_key == "timeline", Scope::Timeline);
+            case Scope::Events:
+                m_out.events.emplace_back().roomId = m_roomId;
+                return Enter(true, Scope::Event);
+            case Scope::Event:
+                return Enter(m_key == "content", Scope::Content);
+            default:
+                return Enter(false, Scope::Root);
+        }
+    }
+
+    bool end_object() { return Leave(); }
+
+    bool start_array(std::size_t) {
+        if (m_skip) { ++m_skip; return true; }
+        return Enter(!m_scopes.empty() && m_scopes.back() == Scope::Timeline && m_key == "events", Scope::Events);
+    }
+
+    bool end_array() { return Leave(); }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) { return false; }
+
+private:
+    bool InEvent() const { return !m_skip && !m_scopes.empty() && m_scopes.back() == Scope::Event; }
+
+    bool Enter(bool wanted, Scope scope) {
+        if (wanted) m_scopes.push_back(scope);
+        else m_skip = 1;
+        m_key.clear();
+        return true;
+    }
+
+    bool Leave() {
+        if (m_skip) --m_skip;
+        else m_scopes.pop_back();
+        m_key.clear();
+        return true;
+    }
+
+    const std::function<bool(std::string_view)>& m_wantRoom;
+    SyncBatch& m_out;
+    std::vector<Scope> m_scopes;
+    size_t m_skip = 0;       // depth inside a value nobody asked for
+    std::string m_key;       // last key seen in the current object
+    std::string m_roomId;
+};
+
+} // namespace
+
+bool ParseSync(std::string_view body, const std::function<bool(std::string_view roomId)>& wantRoom, SyncBatch& out) {
+    out.nextBatch.clear();
+    out.events.clear();
+    SyncSax sax(wantRoom, out);
+    return json::sax_parse(body.begin(), body.end(), &sax);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One timeline event from rooms.join.<room>.timeline.events of a /sync response
+struct SyncTimelineEvent {
+    std::string roomId;
+    std::string eventId;
+    std::string sender;
+    std::string type;
+    std::string msgtype;  // content.msgtype
+    std::string body;     // content.body
+    uint64_t originServerTs = 0;
+};
+
+struct SyncBatch {
+    std::string nextBatch;
+    std::vector<SyncTimelineEvent> events; // in response order
+};
+
+// Streams over a /sync body with a SAX parser instead of building a DOM. Only next_batch and the
+// timeline events of joined rooms for which `wantRoom` returns true are kept; everything else
+// (presence, account data, state, other rooms) is tokenized and dropped. False on malformed JSON.
+bool ParseSync(std::string_view json, const std::function<bool(std::string_view roomId)>& wantRoom, SyncBatch& out);
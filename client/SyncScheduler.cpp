@@ -0,0 +1,71 @@
+#include "SyncScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+SyncScheduler::SyncScheduler(const SyncPolicy& policy)
+    : m_policy(policy) {}
+
+void SyncScheduler::SetPolicy(const SyncPolicy& policy) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_policy = policy;
+}
+
+std::chrono::milliseconds SyncScheduler::NextTimeout(bool initial) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool immediate = initial || m_wakePending;
+    m_wakePending = false;
+    return immediate ? std::chrono::milliseconds(0) : m_policy.longPollTimeout;
+}
+
+void SyncScheduler::OnSuccess() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failures = 0;
+}
+
+void SyncScheduler::OnFailure() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_wakePending) m_failures++; // a poll cut short by Wake() is not the server's fault
+}
+
+bool SyncScheduler::WaitForTurn() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_failures && !m_wakePending) {
+        auto delay = BackoffDelay(m_failures);
+        m_cv.wait_for(lock, delay, [this] { return m_stopped || m_wakePending; });
+    }
+    return !m_stopped;
+}
+
+void SyncScheduler::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wakePending = true;
+    }
+    m_cv.notify_all();
+}
+
+void SyncScheduler::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_cv.notify_all();
+}
+
+void SyncScheduler::Reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = false;
+    m_failures = 0;
+    m_wakePending = false;
+}
+
+// Caller holds m_mutex (m_rng is not thread-safe)
+std::chrono::milliseconds SyncScheduler::BackoffDelay(unsigned failures) {
+    double delay = m_policy.initialBackoff.count() * std::pow(m_policy.backoffMultiplier, std::min(failures - 1, 32u));
+    delay = std::min(delay, static_cast<double>(m_policy.maxBackoff.count()));
+
+    uint32_t r;
+    m_rng.Fill(&r, sizeof(r));
+    delay *= 1.0 - std::clamp(m_policy.jitter, 0.0, 1.0) * (r / 4294967296.0);
+    return std::chrono::milliseconds(static_cast<int64_t>(delay));
+}
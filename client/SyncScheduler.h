@@ -0,0 +1,52 @@
+#pragma once
+#include "ChaCha20Rng.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// How MatrixClient paces /sync
+struct SyncPolicy {
+    std::chrono::milliseconds longPollTimeout{ 30000 }; // server-side timeout= once caught up
+    std::chrono::milliseconds initialBackoff{ 1000 };   // wait after the first failed sync
+    std::chrono::milliseconds maxBackoff{ 60000 };
+    double backoffMultiplier = 2.0;
+    double jitter = 0.5;                                 // each wait is shortened by a random fraction up to this
+};
+
+// Decides when the next /sync starts and which server timeout it asks for. A successful response
+// is followed by the next poll at once (long-polling with longPollTimeout); the first sync and one
+// requested through Wake() use timeout=0 so they return immediately; failures back off
+// exponentially with jitter until the next success.
+class SyncScheduler {
+public:
+    explicit SyncScheduler(const SyncPolicy& policy = {});
+
+    void SetPolicy(const SyncPolicy& policy);
+
+    // timeout= for the sync about to start; `initial` when there is no since token yet
+    std::chrono::milliseconds NextTimeout(bool initial);
+
+    void OnSuccess();
+    void OnFailure();
+
+    // Blocks until the next sync may start. False once Stop() was called.
+    bool WaitForTurn();
+
+    // Any thread: local activity needs a fresh sync. Ends a backoff wait, makes the next poll
+    // return at once, and keeps the failure of a poll cancelled for this reason off the backoff.
+    void Wake();
+
+    void Stop();
+    void Reset(); // clears Stop() and the failure count
+
+private:
+    std::chrono::milliseconds BackoffDelay(unsigned failures);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    SyncPolicy m_policy;
+    unsigned m_failures = 0;
+    bool m_wakePending = false;
+    bool m_stopped = false;
+    ChaCha20Rng m_rng;
+};
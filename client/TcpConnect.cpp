@@ -0,0 +1,109 @@
+#include "TcpConnect.h"
+#include <algorithm>
+#include <vector>
+
+// Wait in short slices so a cancel request is noticed without waking the socket
+static constexpr std::chrono::milliseconds kCancelSlice{ 50 };
+
+static int MillisUntil(std::chrono::steady_clock::time_point t) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(t - std::chrono::steady_clock::now());
+    return static_cast<int>(std::clamp<int64_t>(left.count(), 0, kCancelSlice.count()));
+}
+
+static bool Cancelled(const TcpConnectOptions& options) {
+    return options.cancel && options.cancel->load();
+}
+
+// RFC 8305 section 4: start with the family of the first answer, then alternate
+static std::vector<const addrinfo*> InterleaveFamilies(const addrinfo* list) {
+    std::vector<const addrinfo*> first, other;
+    for (const addrinfo* ai = list; ai; ai = ai->ai_next) {
+        if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+        (ai->ai_family == list->ai_family ? first : other).push_back(ai);
+    }
+
+    std::vector<const addrinfo*> ordered;
+    ordered.reserve(first.size() + other.size());
+    for (size_t i = 0; i < std::max(first.size(), other.size()); ++i) {
+        if (i < first.size()) ordered.push_back(first[i]);
+        if (i < other.size()) ordered.push_back(other[i]);
+    }
+    return ordered;
+}
+
+SOCKET TcpConnect(const std::string& host, uint16_t port, const TcpConnectOptions& options, std::string& error) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo* list = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &list) != 0 || !list) {
+        error = "cannot resolve " + host;
+        return INVALID_SOCKET;
+    }
+    const auto addresses = InterleaveFamilies(list);
+
+    std::vector<PollFd> inflight;
+    SOCKET winner = INVALID_SOCKET;
+    size_t next = 0;
+    auto nextAttemptAt = std::chrono::steady_clock::now();
+    error = "no usable address for " + host;
+
+    while (winner == INVALID_SOCKET) {
+        if (Cancelled(options)) { error = "cancelled"; break; }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= options.deadline) { error = "timed out"; break; }
+
+        if (next < addresses.size() && (inflight.empty() || now >= nextAttemptAt)) {
+            const addrinfo* ai = addresses[next++];
+            SOCKET s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (s == INVALID_SOCKET) continue;
+            Net::SetNonBlocking(s, true);
+            if (connect(s, ai->ai_addr, static_cast<socklen_t>(ai->ai_addrlen)) == 0) {
+                winner = s;
+                break;
+            }
+            if (!Net::ConnectInProgress(Net::LastError())) {
+                error = "connect failed (" + std::to_string(Net::LastError()) + ")";
+                closesocket(s);
+                continue;
+            }
+            inflight.push_back({ s, POLLOUT, 0 });
+            nextAttemptAt = now + options.attemptDelay;
+            continue;
+        }
+        if (inflight.empty()) break; // every address failed
+
+        auto wakeAt = next < addresses.size() ? std::min(nextAttemptAt, options.deadline) : options.deadline;
+        if (Net::Poll(inflight.data(), inflight.size(), MillisUntil(wakeAt)) <= 0) continue;
+
+        for (size_t i = 0; i < inflight.size();) {
+            if (!inflight[i].revents) { ++i; continue; }
+            int err = Net::SocketError(inflight[i].fd);
+            if (err == 0 && (inflight[i].revents & POLLOUT)) {
+                winner = inflight[i].fd;
+                inflight.erase(inflight.begin() + i);
+                break;
+            }
+            error = "connect failed (" + std::to_string(err) + ")";
+            closesocket(inflight[i].fd);
+            inflight.erase(inflight.begin() + i);
+            nextAttemptAt = std::chrono::steady_clock::now(); // a failure starts the next attempt at once
+        }
+    }
+
+    for (const auto& fd : inflight) closesocket(fd.fd);
+    freeaddrinfo(list);
+    return winner;
+}
+
+bool WaitSocket(SOCKET s, bool forWrite, const TcpConnectOptions& options) {
+    for (;;) {
+        if (Cancelled(options) || std::chrono::steady_clock::now() >= options.deadline) return false;
+        PollFd fd{ s, static_cast<short>(forWrite ? POLLOUT : POLLIN), 0 };
+        int n = Net::Poll(&fd, 1, MillisUntil(options.deadline));
+        if (n < 0) return false;
+        if (n > 0) return (fd.revents & POLLNVAL) == 0; // errors surface in the following send/recv
+    }
+}
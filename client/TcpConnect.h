@@ -0,0 +1,20 @@
+#pragma once
+#include "SocketCompat.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+struct TcpConnectOptions {
+    std::chrono::steady_clock::time_point deadline;
+    const std::atomic<bool>* cancel = nullptr;        // polled while waiting; set it to abort
+    std::chrono::milliseconds attemptDelay{ 250 };     // RFC 8305 "Connection Attempt Delay"
+};
+
+// Resolves `host` (name or literal, IPv4 or IPv6) and connects with Happy Eyeballs (RFC 8305):
+// addresses are tried alternating between families, a new attempt starts every attemptDelay
+// (or as soon as one fails) while earlier ones stay in flight, and the first to complete wins.
+// Returns a connected non-blocking socket, or INVALID_SOCKET with the reason in `error`.
+SOCKET TcpConnect(const std::string& host, uint16_t port, const TcpConnectOptions& options, std::string& error);
+
+// Waits until `s` is readable (or writable). False on deadline, cancel or socket error.
+bool WaitSocket(SOCKET s, bool forWrite, const TcpConnectOptions& options);
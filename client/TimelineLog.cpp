@@ -0,0 +1,204 @@
+#include "TimelineLog.h"
+#include <bit>
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little, "the log format is written as in memory");
+
+static constexpr char kMagic[8] = { 'T', 'A', 'L', 'K', 'L', 'O', 'G', '1' };
+static constexpr uint64_t kCommittedOffset = 8; // followed by the count and their check
+static constexpr size_t kHeaderSize = 40;       // without the room ID
+static constexpr size_t kRecordHeaderSize = 16;
+static constexpr size_t kTrailerSize = 4;
+static constexpr size_t kMinRecordSize = kRecordHeaderSize + kTrailerSize;
+
+template <typename T>
+static T Load(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static void Put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Catches a header field overwritten by something other than WriteHeader()
+static uint64_t HeaderCheck(uint64_t committed, uint64_t count) {
+    uint64_t h = committed * 0x9E3779B97F4A7C15ull ^ count;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 29);
+}
+
+// Whether a whole record starts at `offset` and ends by `limit` with a matching trailer
+static bool ValidRecord(const char* data, uint64_t offset, uint64_t limit, uint64_t& end) {
+    if (limit - offset < kMinRecordSize) return false;
+    const char* p = data + offset;
+    end = offset + kMinRecordSize + Load<uint32_t>(p + 8) + Load<uint16_t>(p + 12) + Load<uint16_t>(p + 14);
+    return end <= limit && Load<uint32_t>(data + end - kTrailerSize) == end - offset;
+}
+
+bool TimelineLog::Open(const std::filesystem::path& path, std::string_view roomId) {
+    Close();
+    if (!m_file.Open(path)) return false;
+
+    if (m_file.Size() == 0) {
+        std::string header(kMagic, sizeof(kMagic));
+        Put<uint64_t>(header, kHeaderSize + roomId.size());
+        Put<uint64_t>(header, 0);
+        Put<uint64_t>(header, HeaderCheck(kHeaderSize + roomId.size(), 0));
+        Put<uint32_t>(header, static_cast<uint32_t>(roomId.size()));
+        Put<uint32_t>(header, 0);
+        header.append(roomId);
+        if (roomId.empty() || roomId.size() > UINT16_MAX || !m_file.Write(0, header.data(), header.size())) {
+            m_file.Close();
+            return false;
+        }
+    }
+
+    auto fail = [this] {
+        m_file.Close();
+        m_roomId.clear();
+        m_offsets.clear();
+        m_count = 0;
+        return false;
+    };
+    if (!m_file.Map()) return fail();
+
+    const char* data = m_file.Data();
+    uint64_t size = m_file.MappedSize();
+    if (size < kHeaderSize || std::memcmp(data, kMagic, sizeof(kMagic)) != 0) return fail();
+    uint64_t committed = Load<uint64_t>(data + kCommittedOffset);
+    uint64_t count = Load<uint64_t>(data + kCommittedOffset + 8);
+    uint64_t check = Load<uint64_t>(data + kCommittedOffset + 16);
+    m_start = kHeaderSize + Load<uint32_t>(data + 32);
+    if (m_start == kHeaderSize || m_start > size) return fail();
+    std::string_view stored(data + kHeaderSize, m_start - kHeaderSize);
+    if (!roomId.empty() && stored != roomId) return fail();
+    m_roomId.assign(stored);
+
+    // The header is trusted when its last record is intact; nothing before it is read
+    bool trusted = check == HeaderCheck(committed, count) && committed >= m_start && committed <= size && count <= (committed - m_start) / kMinRecordSize;
+    if (trusted && count == 0) {
+        trusted = committed == m_start;
+    } else if (trusted) {
+        uint64_t length = Load<uint32_t>(data + committed - kTrailerSize), end;
+        trusted = length <= committed - m_start && ValidRecord(data, committed - length, committed, end) && end == committed;
+    }
+    if (trusted) {
+        m_end = committed;
+        m_count = static_cast<size_t>(count);
+    } else {
+        Recover();
+    }
+
+    // An uncommitted or torn batch: cut it off so appends continue at a record boundary
+    if (!trusted || m_file.Size() != m_end) {
+        if (!m_file.Truncate(m_end) || !WriteHeader(m_end, m_count) || !m_file.Map()) return fail();
+    }
+    return true;
+}
+
+void TimelineLog::Recover() {
+    const char* data = m_file.Data();
+    uint64_t size = m_file.MappedSize();
+    uint64_t offset = m_start, end;
+    m_offsets.clear();
+    while (ValidRecord(data, offset, size, end)) {
+        m_offsets.push_back(offset);
+        offset = end;
+    }
+    m_end = offset;
+    m_count = m_offsets.size();
+}
+
+void TimelineLog::Close() {
+    if (!m_file.IsOpen()) return;
+    Flush();
+    m_file.Close();
+    m_roomId.clear();
+    m_offsets.clear();
+    m_pending.clear();
+    m_start = m_end = 0;
+    m_count = 0;
+}
+
+void TimelineLog::Append(std::string_view eventId, std::string_view sender, std::string_view body, uint64_t originServerTs) {
+    eventId = eventId.substr(0, UINT16_MAX);
+    sender = sender.substr(0, UINT16_MAX);
+    body = body.substr(0, UINT32_MAX - kMinRecordSize - 2 * UINT16_MAX);
+
+    m_offsets.push_back(m_end + m_pending.size());
+    m_count++;
+    Put<uint64_t>(m_pending, originServerTs);
+    Put<uint32_t>(m_pending, static_cast<uint32_t>(body.size()));
+    Put<uint16_t>(m_pending, static_cast<uint16_t>(eventId.size()));
+    Put<uint16_t>(m_pending, static_cast<uint16_t>(sender.size()));
+    m_pending.append(eventId);
+    m_pending.append(sender);
+    m_pending.append(body);
+    Put<uint32_t>(m_pending, static_cast<uint32_t>(kMinRecordSize + eventId.size() + sender.size() + body.size()));
+}
+
+bool TimelineLog::Flush() {
+    if (m_pending.empty()) return true;
+    if (!m_file.IsOpen()) return false;
+    uint64_t end = m_end + m_pending.size();
+    if (!m_file.Write(m_end, m_pending.data(), m_pending.size()) || !WriteHeader(end, m_count)) return false;
+    m_end = end;
+    m_pending.clear();
+    return true;
+}
+
+bool TimelineLog::WriteHeader(uint64_t committed, uint64_t count) {
+    uint64_t fields[3] = { committed, count, HeaderCheck(committed, count) };
+    return m_file.Write(kCommittedOffset, fields, sizeof(fields));
+}
+
+bool TimelineLog::IndexFrom(size_t index) {
+    while (m_count - m_offsets.size() > index) {
+        // Everything before the oldest indexed record is flushed
+        uint64_t end = m_offsets.empty() ? m_end : m_offsets.front();
+        if (end > m_file.MappedSize() && !m_file.Map()) return false;
+        if (end - m_start < kMinRecordSize) return false;
+
+        const char* data = m_file.Data();
+        uint64_t length = Load<uint32_t>(data + end - kTrailerSize), check;
+        if (length > end - m_start || !ValidRecord(data, end - length, end, check) || check != end) return false;
+        m_offsets.push_front(end - length);
+    }
+    return true;
+}
+
+const char* TimelineLog::RecordData(uint64_t offset) {
+    if (offset >= m_end) return m_pending.data() + (offset - m_end);
+    // Batches are written whole before a view is made, so a record starting inside it ends inside it
+    if (offset >= m_file.MappedSize() && !m_file.Map()) return nullptr;
+    return m_file.Data() + offset;
+}
+
+TimelineRecord TimelineLog::Get(size_t index) {
+    if (index >= m_count || !IndexFrom(index)) return {};
+    const char* p = RecordData(m_offsets[index - (m_count - m_offsets.size())]);
+    if (!p) return {};
+    size_t bodySize = Load<uint32_t>(p + 8);
+    size_t eventIdSize = Load<uint16_t>(p + 12);
+    size_t senderSize = Load<uint16_t>(p + 14);
+    const char* strings = p + kRecordHeaderSize;
+
+    TimelineRecord record;
+    record.originServerTs = Load<uint64_t>(p);
+    record.eventId = { strings, eventIdSize };
+    record.sender = { strings + eventIdSize, senderSize };
+    record.body = { strings + eventIdSize + senderSize, bodySize };
+    return record;
+}
+
+bool TimelineLog::ContainsRecent(std::string_view eventId, size_t window) {
+    size_t stop = m_count > window ? m_count - window : 0;
+    for (size_t i = m_count; i > stop; --i) {
+        if (Get(i - 1).eventId == eventId) return true;
+    }
+    return false;
+}
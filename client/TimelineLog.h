@@ -0,0 +1,75 @@
+#pragma once
+#include "MappedFile.h"
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// One stored timeline event; the views point into the log and are valid until its next call
+struct TimelineRecord {
+    std::string_view eventId;
+    std::string_view sender;
+    std::string_view body; // UTF-8
+    uint64_t originServerTs = 0;
+};
+
+// Append-only event log of one room in a single file, read through a memory map.
+//
+//     header   "TALKLOG1", u64 committed length, u64 record count, u64 check of both,
+//              u32 room ID length, u32 0, room ID
+//     record   u64 origin_server_ts, u32 body length, u16 event ID length, u16 sender length,
+//              event ID, sender, body, u32 record length
+//
+// Little-endian, unpadded. Append() only encodes into memory; Flush() writes the buffered
+// records with one write and then the new committed length and count, so a batch cut short by a
+// crash is ignored and cut off at the next Open().
+//
+// Open() maps the file and checks only the last record, so it takes the same time for any
+// number of records. The index of record offsets is built backwards from the newest record
+// through the trailing lengths, as far as Get() has asked for; showing recent history never
+// touches the older part of the file. A file whose header does not match its last record is
+// recovered by walking it front to back. Not thread-safe; TimelineStore serializes access.
+class TimelineLog {
+public:
+    TimelineLog() = default;
+    ~TimelineLog() { Close(); }
+
+    TimelineLog(const TimelineLog&) = delete;
+    TimelineLog& operator=(const TimelineLog&) = delete;
+
+    // Opens or creates the log at `path`. An empty `roomId` accepts whichever room an existing
+    // file belongs to; otherwise the file must be that room's (or new). False on I/O errors,
+    // another format or another room.
+    bool Open(const std::filesystem::path& path, std::string_view roomId);
+    // Flushes first
+    void Close();
+
+    const std::string& RoomId() const { return m_roomId; }
+    size_t Size() const { return m_count; } // records, buffered ones included
+    size_t PendingBytes() const { return m_pending.size(); }
+    size_t IndexedCount() const { return m_offsets.size(); }
+
+    void Append(std::string_view eventId, std::string_view sender, std::string_view body, uint64_t originServerTs);
+    // False if the write failed; the records stay buffered for the next try
+    bool Flush();
+
+    // 0 is the oldest record. Empty if the file is damaged before the newest records.
+    TimelineRecord Get(size_t index);
+    // Whether `eventId` is among the newest `window` records
+    bool ContainsRecent(std::string_view eventId, size_t window);
+
+private:
+    void Recover();                           // forward walk when the header cannot be trusted
+    bool IndexFrom(size_t index);             // extends m_offsets back to `index`
+    const char* RecordData(uint64_t offset);  // remaps when `offset` was flushed after the last Map()
+    bool WriteHeader(uint64_t committed, uint64_t count);
+
+    MappedFile m_file;
+    std::string m_roomId;
+    uint64_t m_start = 0;             // first record
+    uint64_t m_end = 0;               // committed length: end of the last flushed record
+    size_t m_count = 0;
+    std::deque<uint64_t> m_offsets;   // offsets of records [m_count - size(), m_count), ascending
+    std::string m_pending;            // encoded records from m_end on, not yet written
+};
@@ -0,0 +1,155 @@
+#include "TimelineStore.h"
+
+static constexpr const char* kExtension = ".tlog";
+
+TimelineStore::TimelineStore(std::chrono::milliseconds flushDelay) : m_delay(flushDelay) {}
+
+TimelineStore::~TimelineStore() {
+    Close();
+}
+
+std::string TimelineStore::FileName(std::string_view id) {
+    // FNV-1a: unlike std::hash, the same on every build
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : id) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; --i, hash >>= 4) name[i] = hex[hash & 15];
+    return name;
+}
+
+bool TimelineStore::Open(const std::filesystem::path& dir) {
+    Close();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (!std::filesystem::is_directory(dir, ec)) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dir = dir;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != kExtension) continue;
+        auto log = std::make_unique<TimelineLog>();
+        if (!log->Open(entry.path(), {}) || m_rooms.Find(log->RoomId())) continue;
+        std::string roomId = log->RoomId();
+        m_rooms.Emplace(roomId, std::move(log));
+    }
+    m_open = true;
+    m_stop = false;
+    m_thread = std::thread(&TimelineStore::Run, this);
+    return true;
+}
+
+void TimelineStore::Close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open) return;
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FlushLocked();
+    m_rooms = {}; // each log flushes once more and unmaps
+    m_open = false;
+}
+
+bool TimelineStore::IsOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_open;
+}
+
+TimelineLog* TimelineStore::RoomLog(std::string_view roomId) {
+    if (auto* found = m_rooms.Find(roomId)) return found->get();
+    auto log = std::make_unique<TimelineLog>();
+    if (!log->Open(m_dir / (FileName(roomId) + kExtension), roomId)) {
+        m_stats.writeErrors++;
+        log.reset(); // remembered as failed, not retried every event
+    }
+    return m_rooms.Emplace(roomId, std::move(log)).get();
+}
+
+bool TimelineStore::Append(std::string_view roomId, std::string_view eventId, std::string_view sender,
+                           std::string_view body, uint64_t originServerTs) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open) return true;
+        TimelineLog* log = RoomLog(roomId);
+        if (!log) return true;
+        if (!eventId.empty() && log->ContainsRecent(eventId, kResumeWindow)) {
+            m_stats.duplicates++;
+            return false;
+        }
+        log->Append(eventId, sender, body, originServerTs);
+        m_stats.appended++;
+        if (m_dirty) return true; // the writer is already waiting out the delay
+        m_dirty = true;
+    }
+    m_cv.notify_all();
+    return true;
+}
+
+void TimelineStore::Flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FlushLocked();
+}
+
+void TimelineStore::FlushLocked() {
+    // Writes land in the OS cache, so holding the lock here costs appenders microseconds
+    bool failed = false;
+    for (const auto& entry : m_rooms.Entries()) {
+        TimelineLog* log = entry.value.get();
+        if (!log || log->PendingBytes() == 0) continue;
+        size_t bytes = log->PendingBytes();
+        if (log->Flush()) {
+            m_stats.flushes++;
+            m_stats.bytesWritten += bytes;
+        } else {
+            m_stats.writeErrors++;
+            failed = true; // kept buffered, tried again next round
+        }
+    }
+    m_dirty = failed;
+}
+
+void TimelineStore::Run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_stop || m_dirty; });
+        // Let the rest of a sync batch land; Close() cuts the wait short and flushes
+        m_cv.wait_for(lock, m_delay, [this] { return m_stop; });
+        FlushLocked();
+        if (m_stop) return;
+    }
+}
+
+std::vector<std::string> TimelineStore::Rooms() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> rooms;
+    for (const auto& entry : m_rooms.Entries()) {
+        if (entry.value && entry.value->Size() > 0) rooms.push_back(entry.key);
+    }
+    return rooms;
+}
+
+size_t TimelineStore::EventCount(std::string_view roomId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto* log = m_rooms.Find(roomId);
+    return log && *log ? (*log)->Size() : 0;
+}
+
+void TimelineStore::ForEachRecent(std::string_view roomId, size_t count, const std::function<void(const TimelineRecord&)>& f) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto* found = m_rooms.Find(roomId);
+    if (!found || !*found) return;
+    TimelineLog& log = **found;
+    for (size_t i = log.Size() > count ? log.Size() - count : 0; i < log.Size(); ++i) f(log.Get(i));
+}
+
+TimelineStore::Stats TimelineStore::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
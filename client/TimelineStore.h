@@ -0,0 +1,81 @@
+#pragma once
+#include "FlatStringMap.h"
+#include "TimelineLog.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Received messages kept on disk across sessions: one TimelineLog per room in a directory. On
+// Open() every log is mapped and indexed, so the last messages of each room can be shown before
+// anything has been fetched. Append() only buffers; a writer thread flushes all rooms' buffered
+// records `flushDelay` after the first of a burst, one write per room.
+//
+// The newest stored events are also where a room resumes: an event already among them (an initial
+// sync re-delivering what the last session stored) is refused by Append() instead of duplicated.
+class TimelineStore {
+public:
+    struct Stats {
+        uint64_t appended = 0;
+        uint64_t duplicates = 0; // refused by Append()
+        uint64_t flushes = 0;    // per room and batch
+        uint64_t bytesWritten = 0;
+        uint64_t writeErrors = 0;
+    };
+
+    explicit TimelineStore(std::chrono::milliseconds flushDelay = std::chrono::milliseconds(1000));
+    ~TimelineStore();
+
+    TimelineStore(const TimelineStore&) = delete;
+    TimelineStore& operator=(const TimelineStore&) = delete;
+
+    // Opens the logs in `dir` (created if missing) and starts the writer, closing a previous
+    // directory first. Unreadable logs are skipped. False if the directory cannot be created.
+    bool Open(const std::filesystem::path& dir);
+    // Writes what is still buffered, then closes every log
+    void Close();
+    bool IsOpen() const;
+
+    // Any thread. False if `eventId` is among the room's newest stored events: the caller has
+    // shown it before and should drop it. While closed nothing is stored and true is returned.
+    bool Append(std::string_view roomId, std::string_view eventId, std::string_view sender,
+                std::string_view body, uint64_t originServerTs);
+    // Writes the buffered events now instead of after the delay
+    void Flush();
+
+    std::vector<std::string> Rooms() const;
+    size_t EventCount(std::string_view roomId) const;
+    // Calls `f` for the newest `count` events of `roomId`, oldest first, holding the store's lock
+    void ForEachRecent(std::string_view roomId, size_t count, const std::function<void(const TimelineRecord&)>& f);
+
+    Stats GetStats() const;
+
+    // Stable 16-hex-digit name for a room or user ID, safe in any file system
+    static std::string FileName(std::string_view id);
+
+private:
+    void Run();
+    void FlushLocked();
+    TimelineLog* RoomLog(std::string_view roomId); // created on first use; null if the file failed
+
+    static constexpr size_t kResumeWindow = 64; // newest events per room checked by Append()
+
+    std::chrono::milliseconds m_delay;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::filesystem::path m_dir;
+    FlatStringMap<std::unique_ptr<TimelineLog>> m_rooms;
+    bool m_open = false;
+    bool m_stop = false;
+    bool m_dirty = false; // some log has buffered records
+    Stats m_stats;
+    std::thread m_thread;
+};
@@ -0,0 +1,77 @@
+#pragma once
+// UTF-8 <-> wchar_t conversion. Win32 APIs on Windows (UTF-16), a plain encoder elsewhere (UTF-32).
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+// Number of UTF-8 bytes WideToUtf8 will write for `ws`.
+inline size_t Utf8Length(std::wstring_view ws) {
+#ifdef _WIN32
+    if (ws.empty()) return 0;
+    return WideCharToMultiByte(CP_UTF8, 0, ws.data(), (int)ws.size(), nullptr, 0, nullptr, nullptr);
+#else
+    size_t n = 0;
+    for (wchar_t wc : ws) {
+        auto c = static_cast<uint32_t>(wc);
+        n += c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+    }
+    return n;
+#endif
+}
+
+// Writes exactly Utf8Length(ws) bytes to `out`.
+inline void WideToUtf8(std::wstring_view ws, char* out, size_t len) {
+#ifdef _WIN32
+    if (len) WideCharToMultiByte(CP_UTF8, 0, ws.data(), (int)ws.size(), out, (int)len, nullptr, nullptr);
+#else
+    (void)len;
+    for (wchar_t wc : ws) {
+        auto c = static_cast<uint32_t>(wc);
+        if (c < 0x80) {
+            *out++ = static_cast<char>(c);
+        } else if (c < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (c >> 6));
+            *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (c >> 12));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (c >> 18));
+            *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+#endif
+}
+
+inline std::wstring Utf8ToWide(std::string_view s) {
+#ifdef _WIN32
+    if (s.empty()) return {};
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0);
+    std::wstring ws(wlen, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), ws.data(), wlen);
+    return ws;
+#else
+    std::wstring ws;
+    ws.reserve(s.size());
+    for (size_t i = 0; i < s.size();) {
+        auto c = static_cast<unsigned char>(s[i]);
+        size_t extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xE ? 2 : (c >> 3) == 0x1E ? 3 : 0;
+        uint32_t cp = extra == 0 ? (c < 0x80 ? c : 0xFFFD) : c & (0x3F >> extra);
+        if (extra && i + extra >= s.size()) { ws.push_back(0xFFFD); break; } // truncated sequence
+        for (size_t k = 1; k <= extra; ++k) cp = (cp << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3F);
+        ws.push_back(static_cast<wchar_t>(cp));
+        i += extra + 1;
+    }
+    return ws;
+#endif
+}
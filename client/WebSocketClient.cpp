@@ -1,19 +1,22 @@
 #include "WebSocketClient.h"
+#include "WebSocketMask.h"
 #include <thread>
 #include <vector>
+#include <cstring>
 #include <string>
-#include <random>
 #include <sstream>
 #include <functional>
 #include <iostream>
-#include <windows.h>
-
-// Link ws2_32.lib
-#pragma comment(lib, "ws2_32.lib")
+#include <mutex>
+#include <cctype>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "Utf8.h"
 
 // ----------------- Minimal SHA-1 -----------------
 struct SHA1Context { uint32_t state[5]; uint32_t count[2]; uint8_t buffer[64]; };
-void SHA1Transform(uint32_t state[5], const uint8_t buffer[64]);
+static void SHA1Transform(uint32_t state[5], const uint8_t buffer[64]);
 void SHA1Init(SHA1Context* context);
 void SHA1Update(SHA1Context* context, const uint8_t* data, size_t len);
 void SHA1Final(uint8_t digest[20], SHA1Context* context);
@@ -121,7 +124,10 @@ std::string ComputeAcceptKey(const std::string& key) {
 // ----------------- Helper Logging -----------------
 static void LogError(const std::string& msg) {
     std::cerr << "[WebSocketClient] ERROR: " << msg << std::endl;
-    MessageBoxA(nullptr, msg.c_str(), "WebSocketClient Error", MB_ICONERROR | MB_OK);
+#ifdef _WIN32
+    // No dialog: errors come from I/O threads, and a dropped link is reported via SetOnStateChange
+    OutputDebugStringA(("[WebSocketClient] ERROR: " + msg + "\n").c_str());
+#endif
 }
 
 static void LogInfo(const std::string& msg) {
@@ -134,128 +140,769 @@ WebSocketClient::WebSocketClient(const std::string& host, uint16_t port, const s
 
 WebSocketClient::~WebSocketClient() {
     Close();
+    for (auto* node : m_freeNodes) delete node;
 }
 
-void WebSocketClient::Connect() {
-    LogInfo("Starting WSA...");
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) {
-        LogError("WSAStartup failed");
-        return;
-    }
+bool WebSocketClient::Connect() {
+    const bool reconnecting = m_state == WebSocketState::Reconnecting; // called by the supervisor
+    if (!reconnecting) SetState(WebSocketState::Connecting);
 
-    m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (m_socket == INVALID_SOCKET) {
-        LogError("Failed to create socket");
-        WSACleanup();
-        return;
+    if (!Net::Startup()) {
+        LogError("WSAStartup failed");
+        if (!reconnecting) SetState(WebSocketState::Disconnected);
+        return false;
     }
 
-    sockaddr_in server{};
-    server.sin_family = AF_INET;
-    server.sin_port = htons(m_port);
-    if (inet_pton(AF_INET, m_host.c_str(), &server.sin_addr) <= 0) {
-        LogError("Invalid server IP address");
-        closesocket(m_socket);
-        WSACleanup();
-        return;
-    }
+    TcpConnectOptions options;
+    options.deadline = std::chrono::steady_clock::now() + m_connectTimeout;
+    options.cancel = &m_cancelConnect;
 
     LogInfo("Connecting to server...");
-    if (connect(m_socket, (sockaddr*)&server, sizeof(server)) != 0) {
-        LogError("Failed to connect to server");
-        closesocket(m_socket);
-        WSACleanup();
-        return;
+    std::string error;
+    SOCKET sock = TcpConnect(m_host, m_port, options, error);
+    if (sock == INVALID_SOCKET) {
+        LogError("Failed to connect to server: " + error);
+        if (!reconnecting) SetState(WebSocketState::Disconnected);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_deflateMutex);
+        m_socket = sock;
     }
 
     LogInfo("Performing handshake...");
-    if (!PerformHandshake()) {
+    m_parser.Reset();
+    if (!PerformHandshake(options)) {
         LogError("WebSocket handshake failed");
-        Close();
-        return;
+        {
+            std::lock_guard<std::mutex> lock(m_deflateMutex);
+            m_socket = INVALID_SOCKET;
+        }
+        closesocket(sock);
+        if (!reconnecting) SetState(WebSocketState::Disconnected);
+        return false;
     }
 
-    LogInfo("Handshake successful, starting receive thread...");
+    m_nextPingAt = std::chrono::steady_clock::now() + m_pingInterval;
+    m_pingPayload = 0;
     m_running = true;
-    m_recvThread = std::thread(&WebSocketClient::ReceiveLoop, this);
+    ReplayDeferred();
+
+    if (m_reactor) {
+        LogInfo("Handshake successful, attaching to reactor...");
+        m_reactor->Add(this);
+    } else {
+        LogInfo("Handshake successful, starting receive and writer threads...");
+        Net::SetNonBlocking(m_socket, false);
+        m_recvThread = std::thread(&WebSocketClient::ReceiveLoop, this);
+        m_writerThread = std::thread(&WebSocketClient::WriterLoop, this);
+    }
+
+    if (m_reconnect && !m_supervisorThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_supervisorMutex);
+            m_stopSupervisor = m_linkLost = false;
+        }
+        m_supervisorThread = std::thread(&WebSocketClient::SupervisorLoop, this);
+    }
+    SetState(WebSocketState::Connected);
+    return true;
+}
+
+std::future<bool> WebSocketClient::ConnectAsync() {
+    if (m_connectThread.joinable()) m_connectThread.join(); // a previous attempt has finished by now
+
+    std::promise<bool> done;
+    auto connected = done.get_future();
+    m_cancelConnect = false;
+    m_connectThread = std::thread([this, done = std::move(done)]() mutable {
+        done.set_value(Connect());
+    });
+    return connected;
 }
 
 void WebSocketClient::Close() {
+    m_closing = true;
+    m_cancelConnect = true;
+    StopSupervisor();
+    if (m_connectThread.joinable() && m_connectThread.get_id() != std::this_thread::get_id())
+        m_connectThread.join();
+    m_cancelConnect = false;
+
+    m_linkUp = false;
+    WakeFlowWaiters();
+    TearDownLink();
+    FailOutbound();
+    {
+        std::lock_guard<std::mutex> lock(m_replayMutex);
+        m_replay.clear();
+        m_replayBytes = 0;
+    }
+    m_closing = false;
+    SetState(WebSocketState::Disconnected);
+}
+
+// Stops the I/O side of the current connection and closes the socket. Queued frames stay queued.
+void WebSocketClient::TearDownLink() {
     m_running = false;
-    if (m_socket != INVALID_SOCKET) {
-        closesocket(m_socket);
-        m_socket = INVALID_SOCKET;
+    if (m_reactor) m_reactor->Remove(this); // before the socket goes, so the fd is not reused under it
+    // shutdown() wakes a blocked recv()/send(); the handle is closed once no thread uses it
+    if (m_socket != INVALID_SOCKET) shutdown(m_socket, SD_BOTH);
+    if (m_recvThread.joinable()) m_recvThread.join();
+    if (m_writerThread.joinable()) {
+        m_wake.release();
+        m_writerThread.join();
+    }
+    SOCKET sock;
+    {
+        std::lock_guard<std::mutex> lock(m_deflateMutex);
+        sock = std::exchange(m_socket, INVALID_SOCKET);
+    }
+    if (sock != INVALID_SOCKET) {
+        closesocket(sock);
         LogInfo("Socket closed");
     }
-    if (m_recvThread.joinable()) m_recvThread.join();
-    WSACleanup();
 }
 
-void WebSocketClient::Send(const std::wstring& message) {
+// ----------------- Outbound queue -----------------
+WebSocketClient::OutboundNode* WebSocketClient::AcquireNode() {
+    {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        if (!m_freeNodes.empty()) {
+            auto* node = m_freeNodes.back();
+            m_freeNodes.pop_back();
+            return node;
+        }
+    }
+    return new OutboundNode;
+}
+
+void WebSocketClient::ReleaseNode(OutboundNode* node) {
+    node->value.bytes.clear(); // keeps capacity for the next frame
+    node->value.done.reset();
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    m_freeNodes.push_back(node);
+}
+
+// Writes the header (with a fresh masking key) and sizes the node for the payload.
+// Returns where the caller should put the unmasked payload.
+uint8_t* WebSocketClient::BeginFrame(OutboundNode* node, uint8_t opcode, size_t payload_len) {
+    uint8_t header[14];
+    size_t header_len = 0;
+    header[header_len++] = 0x80 | opcode; // FIN + opcode
+    if (payload_len <= 125) header[header_len++] = 0x80 | (uint8_t)payload_len;
+    else if (payload_len <= 65535) { header[header_len++] = 0x80 | 126; header[header_len++] = (payload_len>>8)&0xFF; header[header_len++] = payload_len&0xFF; }
+    else { header[header_len++] = 0x80 | 127; for (int i=7;i>=0;--i) header[header_len++] = ((uint64_t)payload_len>>(8*i))&0xFF; }
+
+    {
+        std::lock_guard<std::mutex> lock(m_rngMutex);
+        m_rng.NextMaskKey(header + header_len);
+    }
+    header_len += 4;
+
+    auto& bytes = node->value.bytes;
+    bytes.resize(header_len + payload_len);
+    std::memcpy(bytes.data(), header, header_len);
+    return bytes.data() + header_len;
+}
+
+void WebSocketClient::EnqueueFrame(OutboundNode* node, size_t payload_len) {
+    auto& bytes = node->value.bytes;
+    uint8_t* payload = bytes.data() + bytes.size() - payload_len;
+    ApplyWebSocketMask(payload, payload_len, payload - 4);
+
+    m_queuedBytes += bytes.size();
+    m_outbound.Push(node);
+    WakeWriter();
+}
+
+void WebSocketClient::WakeWriter() {
+    if (!m_reactor) {
+        m_wake.release();
+        return;
+    }
+    if (m_running && !m_writeScheduled.exchange(true)) m_reactor->ScheduleWrite(this);
+}
+
+SendResult WebSocketClient::Send(const std::wstring& message) {
+    SendResult admitted = AdmitSend();
+    if (admitted != SendResult::Queued) return admitted;
+
+    if (!m_linkUp && m_reconnect) {
+        std::string utf8(Utf8Length(message), '\0');
+        WideToUtf8(message, utf8.data(), utf8.size());
+        if (DeferWhileDown(utf8)) return SendResult::Queued;
+        return SendText(utf8); // reconnected meanwhile
+    }
+
+    // The supervisor replaces the socket and deflate context on reconnect under m_deflateMutex
+    size_t len = Utf8Length(message);
+    std::unique_lock<std::mutex> lock(m_deflateMutex);
     if (m_socket == INVALID_SOCKET) {
+        lock.unlock();
         LogError("Cannot send: socket is invalid");
+        return SendResult::NotConnected;
+    }
+    if (m_deflate) {
+        m_deflateIn.resize(len);
+        WideToUtf8(message, reinterpret_cast<char*>(m_deflateIn.data()), len);
+        SendCompressedLocked(m_deflateIn);
+        return SendResult::Queued;
+    }
+    lock.unlock();
+
+    auto* node = AcquireNode();
+    uint8_t* payload = BeginFrame(node, 0x1, len);
+    WideToUtf8(message, reinterpret_cast<char*>(payload), len);
+    EnqueueFrame(node, len);
+    return SendResult::Queued;
+}
+
+SendResult WebSocketClient::Send(std::string_view utf8) {
+    SendResult admitted = AdmitSend();
+    if (admitted != SendResult::Queued) return admitted;
+
+    if (!m_linkUp && DeferWhileDown(utf8)) return SendResult::Queued;
+    return SendText(utf8);
+}
+
+SendResult WebSocketClient::SendText(std::string_view utf8) {
+    std::unique_lock<std::mutex> lock(m_deflateMutex);
+    if (m_socket == INVALID_SOCKET) {
+        lock.unlock();
+        LogError("Cannot send: socket is invalid");
+        return SendResult::NotConnected;
+    }
+    if (m_deflate) {
+        SendCompressedLocked({ reinterpret_cast<const uint8_t*>(utf8.data()), utf8.size() });
+        return SendResult::Queued;
+    }
+    lock.unlock();
+
+    auto* node = AcquireNode();
+    uint8_t* payload = BeginFrame(node, 0x1, utf8.size());
+    std::memcpy(payload, utf8.data(), utf8.size());
+    EnqueueFrame(node, utf8.size());
+    return SendResult::Queued;
+}
+
+// ----------------- Flow control -----------------
+// Applies the backpressure policy before a data frame is queued.
+SendResult WebSocketClient::AdmitSend() {
+    const size_t high = m_flow.highWatermark;
+    if (m_queuedBytes < high) return SendResult::Queued;
+
+    switch (m_flow.policy) {
+        case BackpressurePolicy::DropOldest:
+            if (m_queuedBytes < 2 * high) return SendResult::Queued; // the writer trims the oldest
+            m_sendDropped++; // the writer itself is stalled: drop the newest instead of growing
+            return SendResult::Dropped;
+
+        case BackpressurePolicy::Block:
+            if (!OnIoThread()) {
+                std::unique_lock<std::mutex> lock(m_flowMutex);
+                m_overHigh = true;
+                m_flowCv.wait(lock, [this] { return m_queuedBytes <= m_flow.lowWatermark || !m_linkUp; });
+                return SendResult::Queued;
+            }
+            [[fallthrough]]; // waiting here would stall the thread that drains the queue
+
+        case BackpressurePolicy::Reject:
+            m_overHigh = true;
+            if (m_queuedBytes < high) return SendResult::Queued; // drained while we looked
+            return SendResult::WouldBlock;
+    }
+    return SendResult::Queued;
+}
+
+// Writer or reactor thread: `bytes` left the queue (written, failed or dropped)
+void WebSocketClient::ReleaseQueued(size_t bytes) {
+    if (bytes == 0) return;
+    size_t left = m_queuedBytes.fetch_sub(bytes) - bytes;
+    if (left > m_flow.lowWatermark || !m_overHigh.exchange(false)) return;
+
+    WakeFlowWaiters();
+    if (m_onWritable) m_onWritable();
+}
+
+void WebSocketClient::WakeFlowWaiters() {
+    {
+        std::lock_guard<std::mutex> lock(m_flowMutex); // a waiter is either before its check or asleep
+    }
+    m_flowCv.notify_all();
+}
+
+bool WebSocketClient::OnIoThread() const {
+    if (m_reactor) return m_reactor->OnReactorThread();
+    return std::this_thread::get_id() == m_writerId.load();
+}
+
+// The deflate context is a stream, so compressing and queueing both happen under
+// m_deflateMutex: frames must reach the wire in the order they were compressed.
+void WebSocketClient::SendCompressedLocked(std::span<const uint8_t> utf8) {
+    if (!m_deflate->Compress(utf8, m_deflateOut)) {
+        LogError("Failed to compress message");
         return;
     }
 
-    std::string utf8;
-    int len = WideCharToMultiByte(CP_UTF8, 0, message.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    utf8.resize(len);
-    WideCharToMultiByte(CP_UTF8, 0, message.c_str(), -1, utf8.data(), len, nullptr, nullptr);
+    auto* node = AcquireNode();
+    uint8_t* payload = BeginFrame(node, 0x40 | 0x1, m_deflateOut.size()); // RSV1 + text
+    std::memcpy(payload, m_deflateOut.data(), m_deflateOut.size());
+    EnqueueFrame(node, m_deflateOut.size());
+}
 
-    std::vector<uint8_t> frame;
-    frame.push_back(0x81); // FIN + text
-    size_t payload_len = utf8.size() - 1;
-    if (payload_len <= 125) frame.push_back(0x80 | (uint8_t)payload_len);
-    else if (payload_len <= 65535) { frame.push_back(0x80 | 126); frame.push_back((payload_len>>8)&0xFF); frame.push_back(payload_len&0xFF); }
-    else { frame.push_back(0x80 | 127); for (int i=7;i>=0;--i) frame.push_back((payload_len>>(8*i))&0xFF); }
+std::future<bool> WebSocketClient::Flush() {
+    auto* node = AcquireNode();
+    node->value.done = std::make_unique<std::promise<bool>>();
+    auto result = node->value.done->get_future();
 
-    uint8_t mask[4];
-    std::random_device rd; for (int i=0;i<4;i++) mask[i] = static_cast<uint8_t>(rd());
-    frame.insert(frame.end(), mask, mask+4);
-    for (size_t i=0;i<payload_len;i++) frame.push_back(utf8[i] ^ mask[i%4]);
+    if (!m_running) {
+        node->value.done->set_value(false);
+        ReleaseNode(node);
+        return result;
+    }
 
-    if (send(m_socket, reinterpret_cast<char*>(frame.data()), frame.size(), 0) == SOCKET_ERROR)
-        LogError("Failed to send message");
-    else
-        LogInfo("Message sent successfully");
+    m_outbound.Push(node);
+    WakeWriter();
+    return result;
 }
 
-void WebSocketClient::ReceiveLoop() {
-    std::vector<uint8_t> buffer(2048);
+void WebSocketClient::WriterLoop() {
+    m_writerId = std::this_thread::get_id();
     while (m_running) {
-        int n = recv(m_socket, reinterpret_cast<char*>(buffer.data()), (int)buffer.size(), 0);
+        if (m_pingInterval.count() > 0) {
+            auto wait = m_nextPingAt - std::chrono::steady_clock::now();
+            if (wait.count() > 0) (void)m_wake.try_acquire_for(wait);
+            KeepaliveTick();
+        } else {
+            m_wake.acquire();
+        }
+        DrainOutbound();
+    }
+
+    if (!m_reconnect) FailOutbound(); // otherwise the supervisor salvages what is left
+}
+
+// Connection is gone: whatever is still queued will never be written
+void WebSocketClient::FailOutbound() {
+    CompleteBatch(false);
+    size_t released = 0;
+    while (auto* node = m_outbound.Pop()) {
+        if (node->value.done) node->value.done->set_value(false);
+        released += node->value.bytes.size();
+        ReleaseNode(node);
+    }
+    ReleaseQueued(released);
+}
+
+// ----------------- Keepalive -----------------
+void WebSocketClient::QueueControlFrame(WsOpcode opcode, std::string_view payload) {
+    auto* node = AcquireNode();
+    uint8_t* dst = BeginFrame(node, static_cast<uint8_t>(opcode), payload.size());
+    std::memcpy(dst, payload.data(), payload.size());
+    EnqueueFrame(node, payload.size());
+}
+
+// Writer or reactor thread. Sends a ping every m_pingInterval; the payload is the send time, so the
+// matching pong gives the RTT. A ping left unanswered past m_pongTimeout means the link is dead.
+void WebSocketClient::KeepaliveTick() {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t outstanding = m_pingPayload.load();
+
+    if (outstanding != 0) {
+        auto sentAt = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(outstanding));
+        if (now - sentAt > m_pongTimeout) {
+            LogError("Keepalive timed out, closing connection");
+            m_pingPayload = 0;
+            m_nextPingAt = now + m_pingInterval;
+            shutdown(m_socket, SD_BOTH); // wakes ReceiveLoop with recv() == 0
+        } else if (now >= m_nextPingAt) {
+            // No new ping while one is unanswered: the writer sleeps until the pong deadline
+            m_nextPingAt = sentAt + m_pongTimeout;
+        }
+        return;
+    }
+    if (m_pingInterval.count() <= 0 || now < m_nextPingAt) return;
+
+    uint64_t stamp = static_cast<uint64_t>(now.time_since_epoch().count());
+    char payload[sizeof(stamp)];
+    std::memcpy(payload, &stamp, sizeof(stamp));
+    m_pingPayload = stamp;
+    QueueControlFrame(WsOpcode::Ping, { payload, sizeof(payload) });
+    m_nextPingAt = now + m_pingInterval;
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_pingsSent++;
+}
+
+// Receive thread
+void WebSocketClient::OnPong(std::string_view payload) {
+    uint64_t stamp = 0;
+    if (payload.size() != sizeof(stamp)) return; // unsolicited pong
+    std::memcpy(&stamp, payload.data(), sizeof(stamp));
+
+    uint64_t expected = stamp;
+    if (stamp == 0 || !m_pingPayload.compare_exchange_strong(expected, 0)) return;
+
+    auto sentAt = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(stamp));
+    auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt);
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_rttSamples[m_rttCount % kRttWindow] = static_cast<uint32_t>(std::min<int64_t>(rtt.count(), UINT32_MAX));
+    m_rttCount++;
+}
+
+WebSocketStats WebSocketClient::GetStats() const {
+    WebSocketStats stats;
+    uint32_t samples[kRttWindow];
+    size_t n;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        stats.pingsSent = m_pingsSent;
+        stats.pongsReceived = m_rttCount;
+        n = std::min<size_t>(m_rttCount, kRttWindow);
+        std::copy(m_rttSamples, m_rttSamples + n, samples);
+    }
+    stats.reconnects = m_reconnects;
+    stats.sendDropped = m_sendDropped;
+    {
+        std::lock_guard<std::mutex> lock(m_replayMutex);
+        stats.replayDropped = m_replayDropped;
+    }
+    stats.rttSamples = n;
+    if (n == 0) return stats;
+
+    std::sort(samples, samples + n);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += samples[i];
+    stats.rttMinMs = samples[0] / 1000.0;
+    stats.rttAvgMs = sum / 1000.0 / n;
+    stats.rttP99Ms = samples[std::min(n - 1, (n * 99) / 100)] / 1000.0;
+    return stats;
+}
+
+// Writer thread (blocking socket): keep writing until the queue is empty.
+void WebSocketClient::DrainOutbound() {
+    bool failed = false;
+    while (WritePending() == WriteStatus::Failed) failed = true;
+    if (failed && m_running) LogError("Failed to send message");
+}
+
+// Pops up to kMaxBatch pending frames and writes them with one vectored call, resuming
+// a partially written batch first. Returns Idle once the queue is empty, or WouldBlock
+// when a non-blocking socket is full.
+WebSocketClient::WriteStatus WebSocketClient::WritePending() {
+    for (;;) {
+        if (m_batchCount == 0) {
+            while (m_batchCount < kMaxBatch) {
+                auto* node = m_outbound.Pop();
+                if (!node) break;
+
+                auto& bytes = node->value.bytes;
+                // Control frames and compressed (RSV1) frames are never dropped: with context
+                // takeover the peer's inflate stream needs every compressed frame in order
+                if (m_flow.policy == BackpressurePolicy::DropOldest && !bytes.empty() &&
+                    (bytes[0] & 0x48) == 0 && m_queuedBytes > m_flow.highWatermark) {
+                    m_sendDropped++; // oldest data frame, the peer is too slow for it
+                    ReleaseQueued(bytes.size());
+                    ReleaseNode(node);
+                    continue;
+                }
+
+                m_batch[m_batchCount++] = node;
+                if (bytes.empty()) continue; // flush marker
+                Net::SetIoBuf(m_batchBufs[m_batchBufCount++], bytes.data(), bytes.size());
+            }
+            if (m_batchCount == 0) return WriteStatus::Idle;
+        }
+
+        while (m_batchBufFirst < m_batchBufCount) {
+            long long sent = Net::SendV(m_socket, m_batchBufs + m_batchBufFirst, m_batchBufCount - m_batchBufFirst);
+            if (sent < 0) {
+                if (Net::WouldBlock(Net::LastError())) return WriteStatus::WouldBlock;
+                CompleteBatch(false);
+                return WriteStatus::Failed;
+            }
+            // Short write: skip what went out and resume from there
+            while (m_batchBufFirst < m_batchBufCount && (size_t)sent >= Net::IoBufLen(m_batchBufs[m_batchBufFirst])) {
+                sent -= Net::IoBufLen(m_batchBufs[m_batchBufFirst]);
+                ++m_batchBufFirst;
+            }
+            if (m_batchBufFirst < m_batchBufCount) Net::AdvanceIoBuf(m_batchBufs[m_batchBufFirst], (size_t)sent);
+        }
+        CompleteBatch(true);
+    }
+}
+
+void WebSocketClient::CompleteBatch(bool ok) {
+    size_t released = 0;
+    for (size_t i = 0; i < m_batchCount; ++i) released += m_batch[i]->value.bytes.size();
+    ReleaseQueued(released); // before the Flush() futures, so BufferedAmount() agrees with them
+
+    for (size_t i = 0; i < m_batchCount; ++i) {
+        if (m_batch[i]->value.done) m_batch[i]->value.done->set_value(ok);
+        ReleaseNode(m_batch[i]);
+    }
+    m_batchCount = m_batchBufCount = m_batchBufFirst = 0;
+}
+
+void WebSocketClient::ReceiveLoop() {
+    bool ok = !m_parser.Buffered() || DispatchMessages(); // may have arrived with the handshake response
+    while (ok && m_running) {
+        auto space = m_parser.WritableSpan();
+        int n = recv(m_socket, reinterpret_cast<char*>(space.data()), (int)space.size(), 0);
         if (n <= 0) {
-            LogError("Connection closed or receive failed");
+            if (m_running) LogError("Connection closed or receive failed");
             break;
         }
+        m_parser.Commit(n);
+        ok = DispatchMessages();
+    }
+
+    m_running = false;
+    m_wake.release(); // the writer exits too
+    if (!m_closing) OnConnectionLost();
+}
+
+// Reactor thread: the socket is non-blocking, read until it runs dry.
+bool WebSocketClient::OnReadable() {
+    for (;;) {
+        auto space = m_parser.WritableSpan();
+        int n = recv(m_socket, reinterpret_cast<char*>(space.data()), (int)space.size(), 0);
+        if (n == 0) {
+            LogInfo("Connection closed by server");
+            return false;
+        }
+        if (n < 0) {
+            if (Net::WouldBlock(Net::LastError())) return true;
+            LogInfo("Receive failed");
+            return false;
+        }
+        m_parser.Commit(n);
+        if (!DispatchMessages()) return false;
+        if ((size_t)n < space.size()) return true;
+    }
+}
+
+// Reactor thread: the connection was dropped (or Close() detached it)
+void WebSocketClient::OnDetached() {
+    m_running = false;
+    m_wantWrite = false;
+    if (!m_reconnect) FailOutbound();
+    if (!m_closing) OnConnectionLost();
+}
+
+// Handles every complete message in the parser. Returns false when the connection is done.
+bool WebSocketClient::DispatchMessages() {
+    WsMessage msg;
+    WebSocketFrameParser::Result r;
+    while ((r = m_parser.Next(msg)) == WebSocketFrameParser::Result::Message) {
+        if (msg.opcode == WsOpcode::Close) {
+            LogInfo("Server closed the connection");
+            m_running = false;
+            return false;
+        }
+        if (msg.opcode == WsOpcode::Ping) {
+            QueueControlFrame(WsOpcode::Pong, msg.payload);
+            continue;
+        }
+        if (msg.opcode == WsOpcode::Pong) {
+            OnPong(msg.payload);
+            continue;
+        }
+
+        if (msg.compressed) {
+            if (!m_deflate || !m_deflate->Decompress({ reinterpret_cast<const uint8_t*>(msg.payload.data()), msg.payload.size() },
+                                                     m_inflated, kMaxInflatedSize)) {
+                LogError("Failed to decompress message");
+                m_running = false;
+                return false;
+            }
+            msg.payload = { reinterpret_cast<const char*>(m_inflated.data()), m_inflated.size() };
+        }
 
-        size_t i = 0;
-        while (i < n) {
-            uint8_t b1 = buffer[i++], b2 = buffer[i++];
-            uint64_t payload_len = b2 & 0x7F;
+        if (m_onMessageView) {
+            m_onMessageView(msg.payload);
+            if (!m_running) return false; // closed from inside the callback
+        }
+        if (m_onMessage) m_onMessage(Utf8ToWide(msg.payload));
+        if (!m_running) return false;
+    }
+    if (r == WebSocketFrameParser::Result::Error) {
+        LogError(std::string("Malformed frame: ") + m_parser.LastError());
+        return false;
+    }
+    return true;
+}
+
+// ----------------- Reconnect -----------------
+void WebSocketClient::SetState(WebSocketState state) {
+    if (m_state.exchange(state) != state && m_onStateChange) m_onStateChange(state);
+}
+
+// Receive or reactor thread: the connection dropped without Close()
+void WebSocketClient::OnConnectionLost() {
+    m_linkUp = false;
+    WakeFlowWaiters();
+    if (!m_reconnect) {
+        SetState(WebSocketState::Disconnected);
+        return;
+    }
+    SetState(WebSocketState::Reconnecting);
+    {
+        std::lock_guard<std::mutex> lock(m_supervisorMutex);
+        m_linkLost = true;
+    }
+    m_supervisorCv.notify_one();
+}
+
+void WebSocketClient::StopSupervisor() {
+    {
+        std::lock_guard<std::mutex> lock(m_supervisorMutex);
+        m_stopSupervisor = true;
+        m_linkLost = false;
+    }
+    m_supervisorCv.notify_one();
+    if (m_supervisorThread.joinable() && m_supervisorThread.get_id() != std::this_thread::get_id())
+        m_supervisorThread.join();
+}
+
+void WebSocketClient::SupervisorLoop() {
+    std::unique_lock<std::mutex> lock(m_supervisorMutex);
+    for (;;) {
+        m_supervisorCv.wait(lock, [this] { return m_linkLost || m_stopSupervisor; });
+        if (m_stopSupervisor) return;
+        m_linkLost = false;
+        lock.unlock();
+
+        TearDownLink();
+        SalvageOutbound();
+
+        bool connected = false;
+        for (unsigned attempt = 0; !connected; ++attempt) {
+            if (m_reconnect->maxAttempts && attempt >= m_reconnect->maxAttempts) break;
+            auto delay = BackoffDelay(attempt);
+            LogInfo("Reconnecting in " + std::to_string(delay.count()) + " ms...");
+
+            lock.lock();
+            if (m_supervisorCv.wait_for(lock, delay, [this] { return m_stopSupervisor; })) return;
+            lock.unlock();
+            connected = Connect();
+        }
+
+        if (connected) {
+            m_reconnects++;
+        } else {
+            LogError("Giving up reconnecting");
+            SetState(WebSocketState::Disconnected);
+        }
+        lock.lock();
+    }
+}
+
+std::chrono::milliseconds WebSocketClient::BackoffDelay(unsigned attempt) {
+    const ReconnectPolicy& policy = *m_reconnect;
+    double delay = policy.initialDelay.count() * std::pow(policy.multiplier, std::min(attempt, 32u));
+    delay = std::min(delay, static_cast<double>(policy.maxDelay.count()));
 
-            if (payload_len == 126) payload_len = (buffer[i++]<<8)|buffer[i++];
-            else if (payload_len == 127) { payload_len=0; for(int j=0;j<8;j++) payload_len=(payload_len<<8)|buffer[i++]; }
+    uint32_t r;
+    {
+        std::lock_guard<std::mutex> lock(m_rngMutex);
+        m_rng.Fill(&r, sizeof(r));
+    }
+    delay *= 1.0 - std::clamp(policy.jitter, 0.0, 1.0) * (r / 4294967296.0);
+    return std::chrono::milliseconds(static_cast<int64_t>(delay));
+}
 
-            uint8_t mask[4] = {0,0,0,0};
-            if (b2 & 0x80) for(int j=0;j<4;j++) mask[j]=buffer[i++];
+// Any thread. While a reconnecting client is down, messages wait in m_replay instead of the socket queue.
+bool WebSocketClient::DeferWhileDown(std::string_view utf8) {
+    if (!m_reconnect) return false;
+    std::lock_guard<std::mutex> lock(m_replayMutex);
+    if (m_linkUp) return false; // came back while we waited; ReplayDeferred has already run
+    m_replay.emplace_back(utf8);
+    m_replayBytes += utf8.size();
+    TrimReplayLocked();
+    return true;
+}
 
-            std::string payload;
-            for(uint64_t j=0;j<payload_len;j++){ uint8_t byte=buffer[i++]; if(b2&0x80) byte^=mask[j%4]; payload.push_back(byte); }
+void WebSocketClient::TrimReplayLocked() {
+    while (m_replayBytes > m_reconnect->replayLimitBytes && !m_replay.empty()) {
+        m_replayBytes -= m_replay.front().size();
+        m_replay.pop_front();
+        m_replayDropped++;
+    }
+}
 
-            int wlen = MultiByteToWideChar(CP_UTF8,0,payload.c_str(),-1,nullptr,0);
-            std::wstring wmsg(wlen,L'\0');
-            MultiByteToWideChar(CP_UTF8,0,payload.c_str(),-1,wmsg.data(),wlen);
+// After the handshake, before the I/O side starts: deferred messages go first, then Send() goes direct
+void WebSocketClient::ReplayDeferred() {
+    std::lock_guard<std::mutex> lock(m_replayMutex);
+    if (!m_replay.empty()) LogInfo("Replaying " + std::to_string(m_replay.size()) + " queued messages");
+    for (const auto& message : m_replay) SendText(message);
+    m_replay.clear();
+    m_replayBytes = 0;
+    m_linkUp = true;
+}
 
-            if(m_onMessage) m_onMessage(wmsg);
+// Supervisor thread, link torn down. Text frames still queued never reached the server, so they
+// are unmasked back into the front of the replay buffer. The batch that was mid-write and
+// compressed frames (their deflate context died with the connection) are lost.
+void WebSocketClient::SalvageOutbound() {
+    CompleteBatch(false);
+
+    std::vector<std::string> salvaged;
+    size_t released = 0;
+    while (auto* node = m_outbound.Pop()) {
+        auto& bytes = node->value.bytes;
+        if (node->value.done) {
+            node->value.done->set_value(false);
+        } else if (!bytes.empty() && bytes[0] == (0x80 | 0x1)) { // FIN + text, no RSV1
+            uint8_t len7 = bytes[1] & 0x7F;
+            size_t headerLen = 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0) + 4;
+            uint8_t* payload = bytes.data() + headerLen;
+            ApplyWebSocketMask(payload, bytes.size() - headerLen, payload - 4);
+            salvaged.emplace_back(reinterpret_cast<const char*>(payload), bytes.size() - headerLen);
         }
+        released += bytes.size();
+        ReleaseNode(node);
+    }
+    ReleaseQueued(released);
+    if (salvaged.empty()) return;
+
+    std::lock_guard<std::mutex> lock(m_replayMutex);
+    for (auto it = salvaged.rbegin(); it != salvaged.rend(); ++it) {
+        m_replayBytes += it->size();
+        m_replay.push_front(std::move(*it));
+    }
+    TrimReplayLocked();
+}
+
+// Case-insensitive lookup of an HTTP response header; returns its value without CRLF.
+static std::string_view FindHeader(std::string_view response, std::string_view name) {
+    size_t pos = 0;
+    while ((pos = response.find("\r\n", pos)) != std::string_view::npos) {
+        pos += 2;
+        if (response.size() - pos <= name.size() || response[pos + name.size()] != ':') continue;
+
+        bool match = true;
+        for (size_t i = 0; i < name.size() && match; ++i)
+            match = std::tolower((unsigned char)response[pos + i]) == std::tolower((unsigned char)name[i]);
+        if (!match) continue;
+
+        size_t start = pos + name.size() + 1;
+        size_t end = response.find("\r\n", start);
+        std::string_view value = response.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        return value;
     }
+    return {};
 }
 
-bool WebSocketClient::PerformHandshake() {
+bool WebSocketClient::PerformHandshake(const TcpConnectOptions& options) {
     std::string key_raw(16,'\0');
-    std::random_device rd; for(auto &c:key_raw) c=static_cast<char>(rd());
+    {
+        std::lock_guard<std::mutex> lock(m_rngMutex);
+        m_rng.Fill(key_raw.data(), key_raw.size());
+    }
     std::string key = Base64Encode(reinterpret_cast<const uint8_t*>(key_raw.data()),16);
 
     std::ostringstream request;
@@ -264,25 +911,74 @@ bool WebSocketClient::PerformHandshake() {
             << "Upgrade: websocket\r\n"
             << "Connection: Upgrade\r\n"
             << "Sec-WebSocket-Key: " << key << "\r\n"
-            << "Sec-WebSocket-Version: 13\r\n\r\n";
-
-    if (send(m_socket, request.str().c_str(), (int)request.str().size(), 0) == SOCKET_ERROR) {
+            << "Sec-WebSocket-Version: 13\r\n";
+    const bool offerDeflate = m_deflateOffer && WebSocketDeflate::Available();
+    if (offerDeflate)
+        request << "Sec-WebSocket-Extensions: " << WebSocketDeflate::MakeOffer(*m_deflateOffer) << "\r\n";
+    request << "\r\n";
+
+    // The socket is non-blocking until the handshake is done, so every wait honours the deadline
+    const std::string requestStr = request.str();
+    for (size_t sent = 0; sent < requestStr.size();) {
+        IoBuf buf;
+        Net::SetIoBuf(buf, const_cast<char*>(requestStr.data() + sent), requestStr.size() - sent);
+        long long n = Net::SendV(m_socket, &buf, 1);
+        if (n > 0) { sent += static_cast<size_t>(n); continue; }
+        if (n < 0 && Net::WouldBlock(Net::LastError()) && WaitSocket(m_socket, true, options)) continue;
         LogError("Failed to send handshake request");
         return false;
     }
 
-    char response[1024] = {};
-    int n = recv(m_socket, response, sizeof(response)-1, 0);
-    if (n <= 0) { LogError("Failed to receive handshake response"); return false; }
-    response[n]=0;
-    std::string respStr(response);
+    std::string respStr;
+    size_t headerEnd;
+    while ((headerEnd = respStr.find("\r\n\r\n")) == std::string::npos) {
+        if (respStr.size() > kMaxHandshakeSize) { LogError("Handshake response too large"); return false; }
+        char chunk[1024];
+        int n = recv(m_socket, chunk, sizeof(chunk), 0);
+        if (n > 0) { respStr.append(chunk, n); continue; }
+        if (n < 0 && Net::WouldBlock(Net::LastError()) && WaitSocket(m_socket, false, options)) continue;
+        LogError("Failed to receive handshake response");
+        return false;
+    }
+
+    // Frames the server sent straight after the 101 may have arrived in the same read
+    for (std::string_view rest = std::string_view(respStr).substr(headerEnd + 4); !rest.empty();) {
+        auto space = m_parser.WritableSpan();
+        size_t n = std::min(space.size(), rest.size());
+        std::memcpy(space.data(), rest.data(), n);
+        m_parser.Commit(n);
+        rest.remove_prefix(n);
+    }
+    respStr.resize(headerEnd + 2); // keep the last header's CRLF for FindHeader
 
     std::string expected = ComputeAcceptKey(key);
-    if(respStr.find("101 Switching Protocols")==std::string::npos || respStr.find(expected)==std::string::npos){
+    if (respStr.compare(0, 12, "HTTP/1.1 101") != 0 || FindHeader(respStr, "Sec-WebSocket-Accept") != expected) {
         LogError("Handshake validation failed");
         return false;
     }
 
+    std::unique_ptr<WebSocketDeflate> deflate;
+    std::string_view extensions = FindHeader(respStr, "Sec-WebSocket-Extensions");
+    if (!extensions.empty()) {
+        DeflateParams negotiated;
+        if (!offerDeflate || !WebSocketDeflate::ParseResponse(extensions, *m_deflateOffer, negotiated)) {
+            LogError("Server accepted an extension we did not offer");
+            return false;
+        }
+        deflate = std::make_unique<WebSocketDeflate>(negotiated);
+        if (!deflate->Ok()) {
+            LogError("Failed to initialise permessage-deflate");
+            return false;
+        }
+        LogInfo("permessage-deflate negotiated");
+    }
+    m_parser.SetAllowRsv1(deflate != nullptr);
+    {
+        // Send() may be compressing with the previous connection's context right now
+        std::lock_guard<std::mutex> lock(m_deflateMutex);
+        m_deflate = std::move(deflate);
+    }
+
     LogInfo("Handshake OK");
     return true;
 }
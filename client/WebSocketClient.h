@@ -1,36 +1,282 @@
 #pragma once
-#define WIN32_LEAN_AND_MEAN
 #include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <future>
+#include <semaphore>
+#include <optional>
+#include <span>
+#include <chrono>
 #include <functional>
 #include <thread>
 #include <atomic>
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <windows.h>
-#pragma comment(lib, "Ws2_32.lib")
+#include <deque>
+#include <condition_variable>
+#include "SocketCompat.h"
+#include "WebSocketFrameParser.h"
+#include "MpscQueue.h"
+#include "ChaCha20Rng.h"
+#include "WebSocketDeflate.h"
+#include "WebSocketReactor.h"
+#include "TcpConnect.h"
+
+// Sec-WebSocket-Accept for a given Sec-WebSocket-Key (RFC 6455 4.2.2); servers in bench/ use it too
+std::string ComputeAcceptKey(const std::string& key);
+
+// Keepalive counters and the RTT over the last WebSocketClient::kRttWindow pongs
+struct WebSocketStats {
+    uint64_t pingsSent = 0;
+    uint64_t pongsReceived = 0;
+    size_t rttSamples = 0;
+    double rttMinMs = 0;
+    double rttAvgMs = 0;
+    double rttP99Ms = 0;
+    uint64_t reconnects = 0;
+    uint64_t replayDropped = 0; // messages discarded because the replay buffer was full
+    uint64_t sendDropped = 0;   // messages discarded by BackpressurePolicy::DropOldest
+};
+
+enum class SendResult {
+    Queued,       // accepted (possibly into the replay buffer while reconnecting)
+    WouldBlock,   // over the high watermark; retry after OnWritable
+    Dropped,      // DropOldest could not make room
+    NotConnected,
+};
+
+// What Send() does once more than highWatermark bytes are waiting for the socket
+enum class BackpressurePolicy {
+    Block,        // wait until the queue drains below lowWatermark (WouldBlock on the I/O thread)
+    DropOldest,   // the writer discards the oldest queued messages to get back under the mark
+    Reject,       // return WouldBlock; OnWritable fires below lowWatermark
+};
+
+// DropOldest only discards uncompressed data frames. Once permessage-deflate is negotiated every
+// message is sent compressed (RSV1) and the peer's inflate context depends on all of them, so the
+// writer drops nothing; Send() still returns Dropped, before compressing, at twice highWatermark.
+struct FlowControl {
+    size_t highWatermark = 4 * 1024 * 1024;
+    size_t lowWatermark = 1024 * 1024;
+    BackpressurePolicy policy = BackpressurePolicy::Block;
+};
+
+enum class WebSocketState { Disconnected, Connecting, Connected, Reconnecting };
+
+// Automatic reconnect after the link drops (not after Close()). The delay before attempt n is
+// min(maxDelay, initialDelay * multiplier^n), shortened by a random fraction of up to `jitter`.
+struct ReconnectPolicy {
+    std::chrono::milliseconds initialDelay{ 500 };
+    std::chrono::milliseconds maxDelay{ 30000 };
+    double multiplier = 2.0;
+    double jitter = 0.5;
+    unsigned maxAttempts = 0;             // per outage; 0 keeps trying until Close()
+    size_t replayLimitBytes = 1024 * 1024; // messages sent while down; oldest are dropped beyond this
+};
 
 class WebSocketClient {
 public:
     WebSocketClient(const std::string& host, uint16_t port, const std::string& path = "/");
     ~WebSocketClient();
 
-    void Connect();
+    // Resolves the host, connects (Happy Eyeballs) and performs the handshake, all within the
+    // connect timeout. Returns false if any step fails or Close() cancels it.
+    bool Connect();
+    // Same as Connect() on a background thread; the caller is never blocked.
+    std::future<bool> ConnectAsync();
     void Close();
-    void Send(const std::wstring& message);
+
+    // Deadline for resolve + TCP connect + WebSocket handshake together
+    void SetConnectTimeout(std::chrono::milliseconds timeout) { m_connectTimeout = timeout; }
+
+    // Hand the connection to a shared reactor instead of a receive + writer thread pair.
+    // Must be called before Connect(); callbacks then run on the reactor's thread.
+    void SetReactor(WebSocketReactor* reactor) { m_reactor = reactor; }
+
+    SendResult Send(const std::wstring& message);
+    SendResult Send(std::string_view utf8);
+
+    // Outbound bytes counted against the watermarks: queued, or being written
+    size_t BufferedAmount() const { return m_queuedBytes.load(); }
+    // Must be called before Connect(). Control frames (pings, pongs) bypass the watermarks.
+    void SetFlowControl(const FlowControl& flow) { m_flow = flow; }
+    // Called once the queue drains below lowWatermark after a Send() found it over the high
+    // watermark, on the thread that drained it (usually the writer or reactor). May call Send().
+    void SetOnWritable(std::function<void()> cb) { m_onWritable = std::move(cb); }
+
+    // Send() only queues; the future resolves once everything queued before it has been
+    // written to the socket (true) or dropped because the connection went away (false).
+    std::future<bool> Flush();
+
+    // Offer permessage-deflate in the next Connect(); ignored when built without zlib
+    void EnableDeflate(const DeflateParams& params = {}) { m_deflateOffer = params; }
+
+    // Ping every `interval` (0 disables) and drop the connection when a pong takes longer
+    // than `timeout` (defaults to twice the interval). Takes effect on the next Connect().
+    void SetKeepalive(std::chrono::milliseconds interval, std::chrono::milliseconds timeout = {}) {
+        m_pingInterval = interval;
+        m_pongTimeout = timeout.count() > 0 ? timeout : interval * 2;
+    }
+    WebSocketStats GetStats() const;
+
+    static constexpr size_t kRttWindow = 128;
+
+    // Reconnect with backoff when the connection is lost. Messages sent while it is down are kept
+    // and replayed in order after the next handshake. Must be called before Connect().
+    void EnableReconnect(const ReconnectPolicy& policy = {}) { m_reconnect = policy; }
+
+    // Called on whichever client thread noticed the change. Keep it short, and do not call Close()
+    // from it: that thread may be one Close() has to join.
+    void SetOnStateChange(std::function<void(WebSocketState)> cb) { m_onStateChange = std::move(cb); }
+    WebSocketState GetState() const { return m_state.load(); }
 
     void SetOnMessage(std::function<void(const std::wstring&)> cb) {
         m_onMessage = std::move(cb);
     }
 
+    // Zero-copy delivery: `payload` is the unmasked UTF-8 payload in the receive buffer and is only
+    // valid until the callback returns. Runs before SetOnMessage's callback; when only this one is
+    // set, messages are never transcoded.
+    void SetOnMessageView(std::function<void(std::string_view payload)> cb) {
+        m_onMessageView = std::move(cb);
+    }
+
 private:
+    friend class WebSocketReactor;
+
     void ReceiveLoop();
-    bool PerformHandshake();
+    bool DispatchMessages();
+    bool PerformHandshake(const TcpConnectOptions& options);
+    SendResult SendText(std::string_view utf8);
+    SendResult AdmitSend();
+    void ReleaseQueued(size_t bytes);
+    void WakeFlowWaiters();
+    bool OnIoThread() const;
+    void TearDownLink();
+
+    struct OutboundFrame {
+        std::vector<uint8_t> bytes;                  // complete masked frame; empty for Flush markers
+        std::unique_ptr<std::promise<bool>> done;
+    };
+    using OutboundNode = MpscQueue<OutboundFrame>::Node;
+
+    OutboundNode* AcquireNode();
+    void ReleaseNode(OutboundNode* node);
+    uint8_t* BeginFrame(OutboundNode* node, uint8_t opcode, size_t payload_len);
+    void EnqueueFrame(OutboundNode* node, size_t payload_len);
+    void WakeWriter();
+    void WriterLoop();
+    void DrainOutbound();
+    void FailOutbound();
+
+    enum class WriteStatus { Idle, WouldBlock, Failed };
+    WriteStatus WritePending();
+    void CompleteBatch(bool ok);
+
+    // Reactor callbacks (reactor thread)
+    bool OnReadable();
+    void OnDetached();
+
+    void SendCompressedLocked(std::span<const uint8_t> utf8);
+    void QueueControlFrame(WsOpcode opcode, std::string_view payload);
+    void KeepaliveTick();
+    void OnPong(std::string_view payload);
+
+    // Reconnect supervisor
+    void SetState(WebSocketState state);
+    void OnConnectionLost();
+    void SupervisorLoop();
+    void StopSupervisor();
+    std::chrono::milliseconds BackoffDelay(unsigned attempt);
+    bool DeferWhileDown(std::string_view utf8);
+    void ReplayDeferred();
+    void SalvageOutbound();
+    void TrimReplayLocked();
+
+    static constexpr size_t kMaxInflatedSize = 16 * 1024 * 1024;
+    static constexpr size_t kMaxBatch = 64;
+    static constexpr size_t kMaxHandshakeSize = 16 * 1024;
 
     std::string m_host;
     std::string m_path;
     uint16_t m_port;
     SOCKET m_socket{ INVALID_SOCKET };
+    std::chrono::milliseconds m_connectTimeout{ 10000 };
+    std::atomic<bool> m_cancelConnect{ false };
+    std::thread m_connectThread;
     std::thread m_recvThread;
     std::atomic<bool> m_running{ false };
+    WebSocketFrameParser m_parser;
+
+    // Outbound: any thread pushes, m_writerThread drains. Nodes are recycled through
+    // m_freeNodes so a warmed-up connection does not allocate per message.
+    MpscQueue<OutboundFrame> m_outbound;
+    std::counting_semaphore<> m_wake{ 0 };
+    std::thread m_writerThread;
+    std::mutex m_poolMutex;
+    std::vector<OutboundNode*> m_freeNodes;
+
+    // Flow control: bytes are counted when a frame is queued and released once written or dropped
+    FlowControl m_flow;
+    std::atomic<size_t> m_queuedBytes{ 0 };
+    std::atomic<bool> m_overHigh{ false }; // a sender saw the high watermark; notify below low
+    std::atomic<uint64_t> m_sendDropped{ 0 };
+    std::atomic<std::thread::id> m_writerId;
+    std::mutex m_flowMutex;
+    std::condition_variable m_flowCv;
+
+    // Masking keys and the handshake nonce; seeded once per connection
+    std::mutex m_rngMutex;
+    ChaCha20Rng m_rng;
+
+    // Frames popped for the current vectored write; survives a would-block in reactor mode
+    OutboundNode* m_batch[kMaxBatch] = {};
+    IoBuf m_batchBufs[kMaxBatch] = {};
+    size_t m_batchCount = 0;
+    size_t m_batchBufCount = 0;
+    size_t m_batchBufFirst = 0;
+
+    // Reactor mode
+    WebSocketReactor* m_reactor = nullptr;
+    std::atomic<bool> m_writeScheduled{ false };
+    bool m_wantWrite = false; // reactor thread only
+
+    // Keepalive: the writer (or reactor) thread sends pings, the receiving side times the pongs
+    std::chrono::milliseconds m_pingInterval{ 15000 };
+    std::chrono::milliseconds m_pongTimeout{ 30000 };
+    std::chrono::steady_clock::time_point m_nextPingAt;
+    std::atomic<uint64_t> m_pingPayload{ 0 }; // send time of the unanswered ping, 0 if none
+    mutable std::mutex m_statsMutex;
+    uint64_t m_pingsSent = 0;
+    uint64_t m_rttCount = 0;
+    uint32_t m_rttSamples[kRttWindow] = {}; // microseconds, ring
+
+    // permessage-deflate, set up by PerformHandshake when the server accepts it
+    std::optional<DeflateParams> m_deflateOffer;
+    std::unique_ptr<WebSocketDeflate> m_deflate;
+    std::mutex m_deflateMutex;  // also guards m_socket: Send() reads both while a reconnect swaps them
+    std::vector<uint8_t> m_deflateIn;
+    std::vector<uint8_t> m_deflateOut;
+    std::vector<uint8_t> m_inflated; // receive thread only
+
+    // Reconnect: I/O threads report a lost link, m_supervisorThread tears it down and redials
+    std::optional<ReconnectPolicy> m_reconnect;
+    std::atomic<WebSocketState> m_state{ WebSocketState::Disconnected };
+    std::atomic<bool> m_linkUp{ false };   // Send() goes straight to the socket queue
+    std::atomic<bool> m_closing{ false };  // Close() in progress: a dropped link is not "lost"
+    std::atomic<uint64_t> m_reconnects{ 0 };
+    std::thread m_supervisorThread;
+    std::mutex m_supervisorMutex;
+    std::condition_variable m_supervisorCv;
+    bool m_linkLost = false;
+    bool m_stopSupervisor = false;
+    mutable std::mutex m_replayMutex;
+    std::deque<std::string> m_replay;
+    size_t m_replayBytes = 0;
+    uint64_t m_replayDropped = 0;
+
     std::function<void(const std::wstring&)> m_onMessage;
+    std::function<void(std::string_view)> m_onMessageView;
+    std::function<void(WebSocketState)> m_onStateChange;
+    std::function<void()> m_onWritable;
 };
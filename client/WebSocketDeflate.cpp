@@ -0,0 +1,189 @@
+#include "WebSocketDeflate.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef TALKSTER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// ----------------- Extension negotiation -----------------
+static std::string_view Trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+static bool ParseWindowBits(std::string_view value, int minBits, int& out) {
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') value = value.substr(1, value.size() - 2);
+    if (value.empty() || value.size() > 2) return false;
+    int bits = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') return false;
+        bits = bits * 10 + (c - '0');
+    }
+    if (bits < minBits || bits > 15) return false;
+    out = bits;
+    return true;
+}
+
+std::string WebSocketDeflate::MakeOffer(const DeflateParams& wanted) {
+    std::string offer = "permessage-deflate; client_max_window_bits";
+    if (wanted.clientMaxWindowBits < 15) offer += "=" + std::to_string(wanted.clientMaxWindowBits);
+    if (wanted.serverMaxWindowBits < 15) offer += "; server_max_window_bits=" + std::to_string(wanted.serverMaxWindowBits);
+    if (wanted.clientNoContextTakeover) offer += "; client_no_context_takeover";
+    if (wanted.serverNoContextTakeover) offer += "; server_no_context_takeover";
+    return offer;
+}
+
+bool WebSocketDeflate::ParseResponse(std::string_view header, const DeflateParams& offered, DeflateParams& negotiated) {
+    // Several extensions may be listed, comma separated; find ours
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        std::string_view ext = header.substr(0, comma);
+        header = comma == std::string_view::npos ? std::string_view{} : header.substr(comma + 1);
+
+        size_t semi = ext.find(';');
+        if (Trim(ext.substr(0, semi)) != "permessage-deflate") continue;
+
+        DeflateParams result;
+        result.memLevel = offered.memLevel;
+        result.clientNoContextTakeover = offered.clientNoContextTakeover;
+        result.clientMaxWindowBits = offered.clientMaxWindowBits;
+        result.serverMaxWindowBits = 15;
+        bool sawServerBits = false;
+
+        std::string_view params = semi == std::string_view::npos ? std::string_view{} : ext.substr(semi + 1);
+        while (!params.empty()) {
+            size_t next = params.find(';');
+            std::string_view param = Trim(params.substr(0, next));
+            params = next == std::string_view::npos ? std::string_view{} : params.substr(next + 1);
+            if (param.empty()) continue;
+
+            size_t eq = param.find('=');
+            std::string_view key = Trim(param.substr(0, eq));
+            std::string_view value = eq == std::string_view::npos ? std::string_view{} : Trim(param.substr(eq + 1));
+
+            if (key == "server_no_context_takeover") {
+                result.serverNoContextTakeover = true;
+            } else if (key == "client_no_context_takeover") {
+                result.clientNoContextTakeover = true;
+            } else if (key == "server_max_window_bits") {
+                if (!ParseWindowBits(value, 8, result.serverMaxWindowBits)) return false;
+                sawServerBits = true;
+            } else if (key == "client_max_window_bits") {
+                int bits = 15;
+                if (!ParseWindowBits(value, 8, bits)) return false;
+                result.clientMaxWindowBits = std::min(result.clientMaxWindowBits, std::max(bits, 9));
+            } else {
+                return false; // unknown parameter: RFC 7692 says fail the connection
+            }
+        }
+
+        // What we asked the server to do, it has to confirm
+        if (offered.serverNoContextTakeover && !result.serverNoContextTakeover) return false;
+        if (offered.serverMaxWindowBits < 15 &&
+            (!sawServerBits || result.serverMaxWindowBits > offered.serverMaxWindowBits)) return false;
+
+        negotiated = result;
+        return true;
+    }
+    return false;
+}
+
+// ----------------- zlib streams -----------------
+#ifdef TALKSTER_HAVE_ZLIB
+
+static const uint8_t kTail[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+struct WebSocketDeflate::Streams {
+    z_stream deflater{};
+    z_stream inflater{};
+};
+
+bool WebSocketDeflate::Available() { return true; }
+
+WebSocketDeflate::WebSocketDeflate(const DeflateParams& params) : m_params(params) {
+    auto streams = std::make_unique<Streams>();
+    if (deflateInit2(&streams->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     -std::clamp(params.clientMaxWindowBits, 9, 15),
+                     std::clamp(params.memLevel, 1, 9), Z_DEFAULT_STRATEGY) != Z_OK) return;
+    if (inflateInit2(&streams->inflater, -std::clamp(params.serverMaxWindowBits, 8, 15)) != Z_OK) {
+        deflateEnd(&streams->deflater);
+        return;
+    }
+    m_streams = std::move(streams);
+}
+
+WebSocketDeflate::~WebSocketDeflate() {
+    if (!m_streams) return;
+    deflateEnd(&m_streams->deflater);
+    inflateEnd(&m_streams->inflater);
+}
+
+bool WebSocketDeflate::Compress(std::span<const uint8_t> in, std::vector<uint8_t>& out) {
+    if (!m_streams) return false;
+    z_stream& s = m_streams->deflater;
+
+    s.next_in = const_cast<Bytef*>(in.data());
+    s.avail_in = static_cast<uInt>(in.size());
+
+    size_t used = 0;
+    out.resize(std::max<size_t>(out.capacity(), deflateBound(&s, static_cast<uLong>(in.size())) + 16));
+    do {
+        if (out.size() - used < 64) out.resize(out.size() * 2);
+        s.next_out = out.data() + used;
+        s.avail_out = static_cast<uInt>(out.size() - used);
+        if (deflate(&s, Z_SYNC_FLUSH) == Z_STREAM_ERROR) return false;
+        used = out.size() - s.avail_out;
+    } while (s.avail_out == 0 || s.avail_in > 0);
+
+    out.resize(used);
+    if (used >= 4 && std::memcmp(out.data() + used - 4, kTail, 4) == 0) out.resize(used - 4);
+
+    if (m_params.clientNoContextTakeover) deflateReset(&s);
+    return true;
+}
+
+bool WebSocketDeflate::Decompress(std::span<const uint8_t> in, std::vector<uint8_t>& out, size_t maxSize) {
+    if (!m_streams) return false;
+    z_stream& s = m_streams->inflater;
+
+    size_t used = 0;
+    out.resize(std::min(std::max<size_t>(out.capacity(), in.size() * 4 + 256), maxSize));
+
+    bool ended = false;
+    for (std::span<const uint8_t> chunk : { in, std::span<const uint8_t>(kTail) }) {
+        s.next_in = const_cast<Bytef*>(chunk.data());
+        s.avail_in = static_cast<uInt>(chunk.size());
+        while (!ended && (s.avail_in > 0 || used == out.size())) {
+            if (used == out.size()) {
+                if (out.size() >= maxSize) return false;
+                out.resize(std::min(out.size() * 2 + 256, maxSize));
+            }
+            s.next_out = out.data() + used;
+            s.avail_out = static_cast<uInt>(out.size() - used);
+            int ret = inflate(&s, Z_SYNC_FLUSH);
+            used = out.size() - s.avail_out;
+            if (ret == Z_STREAM_END) ended = true;
+            else if (ret == Z_BUF_ERROR) break;
+            else if (ret != Z_OK) return false;
+        }
+    }
+    out.resize(used);
+
+    // A final block ends the stream; the next message starts a fresh one
+    if (ended || m_params.serverNoContextTakeover) inflateReset(&s);
+    return true;
+}
+
+#else
+
+struct WebSocketDeflate::Streams {};
+
+bool WebSocketDeflate::Available() { return false; }
+WebSocketDeflate::WebSocketDeflate(const DeflateParams& params) : m_params(params) {}
+WebSocketDeflate::~WebSocketDeflate() = default;
+bool WebSocketDeflate::Compress(std::span<const uint8_t>, std::vector<uint8_t>&) { return false; }
+bool WebSocketDeflate::Decompress(std::span<const uint8_t>, std::vector<uint8_t>&, size_t) { return false; }
+
+#endif
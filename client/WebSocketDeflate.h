@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// permessage-deflate (RFC 7692) parameters. Window bits cap the per-direction
+// sliding window (2^bits bytes); "no context takeover" resets it after every message.
+struct DeflateParams {
+    bool clientNoContextTakeover = false;
+    bool serverNoContextTakeover = false;
+    int clientMaxWindowBits = 15; // 9..15 (zlib cannot deflate with an 8-bit window)
+    int serverMaxWindowBits = 15; // 8..15
+    int memLevel = 8;             // zlib deflate memLevel, 1..9
+};
+
+// One compressor (client -> server) and one decompressor (server -> client) per connection.
+class WebSocketDeflate {
+public:
+    explicit WebSocketDeflate(const DeflateParams& params);
+    ~WebSocketDeflate();
+
+    WebSocketDeflate(const WebSocketDeflate&) = delete;
+    WebSocketDeflate& operator=(const WebSocketDeflate&) = delete;
+
+    // False when the build has no zlib; the extension is then never offered.
+    static bool Available();
+
+    // Value for the Sec-WebSocket-Extensions request header.
+    static std::string MakeOffer(const DeflateParams& wanted);
+
+    // Parses the server's Sec-WebSocket-Extensions value. Returns false if it did not
+    // accept permessage-deflate or answered with something we did not offer.
+    static bool ParseResponse(std::string_view header, const DeflateParams& offered, DeflateParams& negotiated);
+
+    // Compresses one whole message into `out` (replaced), without the 00 00 FF FF tail.
+    bool Compress(std::span<const uint8_t> in, std::vector<uint8_t>& out);
+
+    // Inflates one whole message into `out` (replaced). Fails past `maxSize` bytes.
+    bool Decompress(std::span<const uint8_t> in, std::vector<uint8_t>& out, size_t maxSize);
+
+    bool Ok() const { return m_streams != nullptr; }
+
+private:
+    struct Streams;
+    std::unique_ptr<Streams> m_streams;
+    DeflateParams m_params;
+};
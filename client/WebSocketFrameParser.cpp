@@ -0,0 +1,200 @@
+#include "WebSocketFrameParser.h"
+#include "WebSocketMask.h"
+#include <algorithm>
+#include <cstring>
+
+WebSocketFrameParser::WebSocketFrameParser(size_t initialCapacity, size_t maxMessageSize)
+    : m_maxMessageSize(maxMessageSize) {
+    size_t cap = 256;
+    while (cap < initialCapacity) cap <<= 1;
+    m_ring.resize(cap);
+}
+
+void WebSocketFrameParser::Reset() {
+    m_head = m_tail = 0;
+    m_state = State::Header;
+    m_payloadLen = m_payloadDone = 0;
+    m_fragmented = false;
+    m_messageCompressed = false;
+    m_message.clear();
+    m_error = nullptr;
+}
+
+// ----------------- Ring buffer -----------------
+std::span<uint8_t> WebSocketFrameParser::WritableSpan() {
+    if (m_head == m_tail) m_head = m_tail = 0; // empty: start over at the front, keeps frames contiguous
+    if (Buffered() == m_ring.size()) Grow(m_ring.size() * 2);
+
+    const size_t mask = m_ring.size() - 1;
+    const size_t tailIdx = static_cast<size_t>(m_tail) & mask;
+    const size_t headIdx = static_cast<size_t>(m_head) & mask;
+
+    size_t end = m_ring.size();
+    if (m_head != m_tail && tailIdx < headIdx) end = headIdx;
+    return { m_ring.data() + tailIdx, end - tailIdx };
+}
+
+void WebSocketFrameParser::Commit(size_t n) {
+    m_tail += n;
+}
+
+void WebSocketFrameParser::Grow(size_t minCapacity) {
+    size_t cap = m_ring.size();
+    while (cap < minCapacity) cap <<= 1;
+
+    std::vector<uint8_t> bigger(cap);
+    const size_t used = Buffered();
+    const size_t headIdx = static_cast<size_t>(m_head) & (m_ring.size() - 1);
+    const size_t first = std::min(used, m_ring.size() - headIdx);
+    std::memcpy(bigger.data(), m_ring.data() + headIdx, first);
+    std::memcpy(bigger.data() + first, m_ring.data(), used - first);
+
+    m_ring.swap(bigger);
+    m_head = 0;
+    m_tail = used;
+}
+
+uint8_t WebSocketFrameParser::PeekByte(size_t offset) const {
+    return m_ring[static_cast<size_t>(m_head + offset) & (m_ring.size() - 1)];
+}
+
+void WebSocketFrameParser::CopyOut(uint8_t* dst, size_t n) {
+    const size_t headIdx = static_cast<size_t>(m_head) & (m_ring.size() - 1);
+    const size_t first = std::min(n, m_ring.size() - headIdx);
+    std::memcpy(dst, m_ring.data() + headIdx, first);
+    std::memcpy(dst + first, m_ring.data(), n - first);
+    m_head += n;
+}
+
+// ----------------- Frame decoding -----------------
+WebSocketFrameParser::Result WebSocketFrameParser::Fail(const char* why) {
+    m_error = why;
+    return Result::Error;
+}
+
+bool WebSocketFrameParser::ParseHeader() {
+    const size_t avail = Buffered();
+    if (avail < 2) return false;
+
+    const uint8_t b1 = PeekByte(0);
+    const uint8_t b2 = PeekByte(1);
+    const uint8_t len7 = b2 & 0x7F;
+    const bool masked = (b2 & 0x80) != 0;
+
+    size_t headerLen = 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0) + (masked ? 4 : 0);
+    if (avail < headerLen) return false;
+
+    size_t pos = 2;
+    uint64_t payloadLen = len7;
+    if (len7 == 126) {
+        payloadLen = (uint64_t(PeekByte(2)) << 8) | PeekByte(3);
+        pos += 2;
+    } else if (len7 == 127) {
+        payloadLen = 0;
+        for (int j = 0; j < 8; j++) payloadLen = (payloadLen << 8) | PeekByte(2 + j);
+        pos += 8;
+    }
+
+    m_fin = (b1 & 0x80) != 0;
+    m_opcode = b1 & 0x0F;
+
+    const bool rsv1 = (b1 & 0x40) != 0;
+    if (b1 & 0x30) { Fail("Reserved bits set without a negotiated extension"); return false; }
+    if (rsv1 && (!m_allowRsv1 || m_opcode == 0x0 || (m_opcode & 0x8))) { Fail("Unexpected RSV1 bit"); return false; }
+
+    if (m_opcode & 0x8) {
+        if (m_opcode != 0x8 && m_opcode != 0x9 && m_opcode != 0xA) { Fail("Unknown control opcode"); return false; }
+        if (!m_fin || payloadLen > sizeof(m_control)) { Fail("Fragmented or oversized control frame"); return false; }
+    } else if (m_opcode == 0x0) {
+        if (!m_fragmented) { Fail("Continuation frame without a message to continue"); return false; }
+        if (m_message.size() + payloadLen > m_maxMessageSize) { Fail("Message too large"); return false; }
+    } else if (m_opcode == 0x1 || m_opcode == 0x2) {
+        if (m_fragmented) { Fail("New data frame inside a fragmented message"); return false; }
+        if (payloadLen > m_maxMessageSize) { Fail("Message too large"); return false; }
+        m_messageOpcode = m_opcode;
+        m_messageCompressed = rsv1;
+        m_message.clear();
+    } else {
+        Fail("Unknown data opcode");
+        return false;
+    }
+
+    m_masked = masked;
+    if (masked) for (int j = 0; j < 4; j++) m_mask[j] = PeekByte(pos + j);
+
+    m_head += headerLen;
+    m_payloadLen = payloadLen;
+    m_payloadDone = 0;
+    m_state = State::Payload;
+    return true;
+}
+
+WebSocketFrameParser::Result WebSocketFrameParser::Next(WsMessage& out) {
+    if (m_error) return Result::Error;
+
+    for (;;) {
+        if (m_state == State::Header) {
+            if (!ParseHeader()) return m_error ? Result::Error : Result::NeedMore;
+        }
+
+        const size_t avail = Buffered();
+        const uint64_t remaining = m_payloadLen - m_payloadDone;
+
+        // Control frames are tiny: wait for the whole thing, then copy it aside
+        if (m_opcode & 0x8) {
+            if (avail < remaining) return Result::NeedMore;
+            const size_t n = static_cast<size_t>(m_payloadLen);
+            CopyOut(m_control, n);
+            if (m_masked) ApplyWebSocketMask(m_control, n, m_mask, 0);
+            m_state = State::Header;
+            out = { static_cast<WsOpcode>(m_opcode), { reinterpret_cast<const char*>(m_control), n } };
+            return Result::Message;
+        }
+
+        // Single-frame message: let the ring grow until the whole payload is here,
+        // then hand out a view into the ring when it did not wrap around.
+        if (m_fin && !m_fragmented) {
+            if (avail < remaining) return Result::NeedMore;
+            const size_t n = static_cast<size_t>(m_payloadLen);
+            const size_t headIdx = static_cast<size_t>(m_head) & (m_ring.size() - 1);
+
+            uint8_t* data;
+            if (headIdx + n <= m_ring.size()) {
+                data = m_ring.data() + headIdx;
+                m_head += n;
+            } else {
+                m_message.resize(n);
+                data = m_message.data();
+                CopyOut(data, n);
+            }
+            if (m_masked) ApplyWebSocketMask(data, n, m_mask, 0);
+
+            m_state = State::Header;
+            out = { static_cast<WsOpcode>(m_messageOpcode), { reinterpret_cast<const char*>(data), n }, m_messageCompressed };
+            return Result::Message;
+        }
+
+        // Fragmented message: stream each fragment into the reassembly buffer as it arrives,
+        // so consumed bytes never have to be copied again.
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, avail));
+        if (n > 0) {
+            const size_t off = m_message.size();
+            m_message.resize(off + n);
+            CopyOut(m_message.data() + off, n);
+            if (m_masked) ApplyWebSocketMask(m_message.data() + off, n, m_mask, m_payloadDone);
+            m_payloadDone += n;
+        }
+        if (m_payloadDone < m_payloadLen) return Result::NeedMore;
+
+        m_state = State::Header;
+        if (!m_fin) {
+            m_fragmented = true;
+            continue;
+        }
+
+        m_fragmented = false;
+        out = { static_cast<WsOpcode>(m_messageOpcode),
+                { reinterpret_cast<const char*>(m_message.data()), m_message.size() }, m_messageCompressed };
+        return Result::Message;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+
+enum class WsOpcode : uint8_t {
+    Continuation = 0x0,
+    Text         = 0x1,
+    Binary       = 0x2,
+    Close        = 0x8,
+    Ping         = 0x9,
+    Pong         = 0xA,
+};
+
+// A complete data message (reassembled from fragments) or a single control frame.
+// The payload is unmasked and stays valid until the next Next() or WritableSpan() call.
+struct WsMessage {
+    WsOpcode opcode;
+    std::string_view payload;
+    bool compressed = false; // RSV1 was set on the first frame (permessage-deflate)
+};
+
+// Socket-independent, resumable WebSocket frame decoder.
+// Bytes go into a growable ring buffer (WritableSpan + Commit) and Next() pulls out
+// whatever messages are complete, no matter where the stream was split.
+class WebSocketFrameParser {
+public:
+    enum class Result { NeedMore, Message, Error };
+
+    explicit WebSocketFrameParser(size_t initialCapacity = 4096,
+                                  size_t maxMessageSize = 16 * 1024 * 1024);
+
+    // Contiguous free space to recv() into; grows the ring when it is full.
+    std::span<uint8_t> WritableSpan();
+    void Commit(size_t n);
+
+    Result Next(WsMessage& out);
+    void Reset();
+
+    // RSV1 marks a compressed message once permessage-deflate has been negotiated
+    void SetAllowRsv1(bool allow) { m_allowRsv1 = allow; }
+
+    const char* LastError() const { return m_error; }
+    size_t Buffered() const { return static_cast<size_t>(m_tail - m_head); }
+
+private:
+    enum class State { Header, Payload };
+
+    Result Fail(const char* why);
+    bool ParseHeader();
+    uint8_t PeekByte(size_t offset) const;
+    void CopyOut(uint8_t* dst, size_t n);
+    void Grow(size_t minCapacity);
+
+    // Ring storage: capacity is a power of two, head/tail are free-running counters.
+    std::vector<uint8_t> m_ring;
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+
+    // Current frame
+    State m_state = State::Header;
+    bool m_fin = false;
+    uint8_t m_opcode = 0;
+    bool m_masked = false;
+    uint8_t m_mask[4] = {};
+    uint64_t m_payloadLen = 0;
+    uint64_t m_payloadDone = 0;
+
+    // Fragmented data message being reassembled
+    bool m_fragmented = false;
+    uint8_t m_messageOpcode = 0;
+    bool m_messageCompressed = false;
+    std::vector<uint8_t> m_message;
+
+    // Control frames may interleave with fragments, so they get their own buffer
+    uint8_t m_control[125] = {};
+
+    size_t m_maxMessageSize;
+    bool m_allowRsv1 = false;
+    const char* m_error = nullptr;
+};
@@ -0,0 +1,53 @@
+#include "WebSocketMask.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WS_MASK_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WS_MASK_SSE2 1
+#endif
+
+void ApplyWebSocketMask(uint8_t* data, size_t len, const uint8_t mask[4], uint64_t offset) {
+    size_t i = 0;
+
+    // Head: byte-wise until data is 8-byte aligned
+    while (i < len && (reinterpret_cast<uintptr_t>(data + i) & 7) != 0) {
+        data[i] ^= mask[(offset + i) & 3];
+        ++i;
+    }
+    if (i == len) return;
+
+    // The key rotated so that lane 0 lines up with data[i]
+    uint8_t rotated[8];
+    for (int j = 0; j < 8; j++) rotated[j] = mask[(offset + i + j) & 3];
+    uint64_t key64;
+    std::memcpy(&key64, rotated, sizeof(key64));
+
+#ifdef WS_MASK_AVX2
+    const __m256i key256 = _mm256_set1_epi64x(static_cast<long long>(key64));
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(v, key256));
+    }
+#endif
+#ifdef WS_MASK_SSE2
+    const __m128i key128 = _mm_set1_epi64x(static_cast<long long>(key64));
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, key128));
+    }
+#endif
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, sizeof(w));
+        w ^= key64;
+        std::memcpy(data + i, &w, sizeof(w));
+    }
+
+    // Tail
+    for (; i < len; ++i) data[i] ^= mask[(offset + i) & 3];
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// XORs `data` in place with the 4-byte WebSocket masking key.
+// `offset` is the position of data[0] within the frame payload, so a payload
+// can be (un)masked in several chunks. Works on unaligned buffers of any length.
+void ApplyWebSocketMask(uint8_t* data, size_t len, const uint8_t mask[4], uint64_t offset = 0);
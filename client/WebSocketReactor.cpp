@@ -0,0 +1,325 @@
+#include "WebSocketReactor.h"
+#include "WebSocketClient.h"
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+// ----------------- epoll backend -----------------
+#ifdef __linux__
+class EpollPoller : public Poller {
+public:
+    EpollPoller() {
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr; // nullptr marks the wake fd
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeFd, &ev);
+    }
+
+    ~EpollPoller() override {
+        close(m_wakeFd);
+        close(m_epoll);
+    }
+
+    bool Ok() const { return m_epoll >= 0 && m_wakeFd >= 0; }
+
+    bool Add(SOCKET s, void* ctx) override {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = ctx;
+        return epoll_ctl(m_epoll, EPOLL_CTL_ADD, s, &ev) == 0;
+    }
+
+    bool SetWriteInterest(SOCKET s, void* ctx, bool on) override {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP | (on ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.ptr = ctx;
+        return epoll_ctl(m_epoll, EPOLL_CTL_MOD, s, &ev) == 0;
+    }
+
+    void Remove(SOCKET s) override {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, s, nullptr);
+    }
+
+    int Wait(Event* out, int maxEvents, int timeoutMs) override {
+        epoll_event evs[256];
+        int n = epoll_wait(m_epoll, evs, std::min(maxEvents, 256), timeoutMs);
+        int count = 0;
+        for (int i = 0; i < n; ++i) {
+            if (!evs[i].data.ptr) {
+                uint64_t drained;
+                (void)!read(m_wakeFd, &drained, sizeof(drained));
+                continue;
+            }
+            out[count++] = { evs[i].data.ptr,
+                             (evs[i].events & (EPOLLIN | EPOLLRDHUP)) != 0,
+                             (evs[i].events & EPOLLOUT) != 0,
+                             (evs[i].events & (EPOLLERR | EPOLLHUP)) != 0 };
+        }
+        return count;
+    }
+
+    void Wake() override {
+        uint64_t one = 1;
+        (void)!write(m_wakeFd, &one, sizeof(one));
+    }
+
+private:
+    int m_epoll = -1;
+    int m_wakeFd = -1;
+};
+#endif
+
+// ----------------- WSAPoll / poll backend -----------------
+class PollPoller : public Poller {
+public:
+    PollPoller() {
+        // A loopback UDP socket connected to itself is the portable way to interrupt WSAPoll
+        m_wakeSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (m_wakeSock == INVALID_SOCKET) return;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(m_wakeSock, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+            getsockname(m_wakeSock, (sockaddr*)&addr, &len) != 0 ||
+            connect(m_wakeSock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            closesocket(m_wakeSock);
+            m_wakeSock = INVALID_SOCKET;
+            return;
+        }
+        Net::SetNonBlocking(m_wakeSock, true);
+        m_fds.push_back({ m_wakeSock, POLLIN, 0 });
+        m_ctx.push_back(nullptr);
+    }
+
+    ~PollPoller() override {
+        if (m_wakeSock != INVALID_SOCKET) closesocket(m_wakeSock);
+    }
+
+    bool Ok() const { return m_wakeSock != INVALID_SOCKET; }
+
+    bool Add(SOCKET s, void* ctx) override {
+        m_fds.push_back({ s, POLLIN, 0 });
+        m_ctx.push_back(ctx);
+        return true;
+    }
+
+    bool SetWriteInterest(SOCKET s, void*, bool on) override {
+        for (auto& fd : m_fds) {
+            if (fd.fd != s) continue;
+            fd.events = on ? (POLLIN | POLLOUT) : POLLIN;
+            return true;
+        }
+        return false;
+    }
+
+    void Remove(SOCKET s) override {
+        for (size_t i = 1; i < m_fds.size(); ++i) {
+            if (m_fds[i].fd != s) continue;
+            m_fds[i] = m_fds.back();
+            m_ctx[i] = m_ctx.back();
+            m_fds.pop_back();
+            m_ctx.pop_back();
+            return;
+        }
+    }
+
+    int Wait(Event* out, int maxEvents, int timeoutMs) override {
+        int n = Net::Poll(m_fds.data(), m_fds.size(), timeoutMs);
+        if (n <= 0) return 0;
+
+        int count = 0;
+        for (size_t i = 0; i < m_fds.size() && count < maxEvents; ++i) {
+            auto revents = m_fds[i].revents;
+            if (!revents) continue;
+            if (!m_ctx[i]) {
+                char drain[64];
+                while (recv(m_wakeSock, drain, sizeof(drain), 0) > 0) {}
+                continue;
+            }
+            out[count++] = { m_ctx[i],
+                             (revents & POLLIN) != 0,
+                             (revents & POLLOUT) != 0,
+                             (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0 };
+        }
+        return count;
+    }
+
+    void Wake() override {
+        char one = 1;
+        send(m_wakeSock, &one, 1, 0);
+    }
+
+private:
+    SOCKET m_wakeSock = INVALID_SOCKET;
+    std::vector<PollFd> m_fds;
+    std::vector<void*> m_ctx;
+};
+
+std::unique_ptr<Poller> Poller::CreateDefault() {
+#ifdef __linux__
+    auto epoll = std::make_unique<EpollPoller>();
+    if (epoll->Ok()) return epoll;
+#endif
+    Net::Startup(); // the wake socket needs Winsock before any client has connected
+    auto poll = std::make_unique<PollPoller>();
+    if (poll->Ok()) return poll;
+    return nullptr;
+}
+
+// ----------------- WebSocketReactor -----------------
+WebSocketReactor::WebSocketReactor(std::unique_ptr<Poller> poller)
+    : m_poller(std::move(poller)) {
+    if (!m_poller) {
+        std::cerr << "[WebSocketReactor] ERROR: no poller backend available" << std::endl;
+        return;
+    }
+    // The two command buffers swap every round; sized up front so a Send() that schedules a write
+    // does not grow one of them mid-stream
+    m_commands.reserve(kMaxEvents);
+    m_processing.reserve(kMaxEvents);
+    m_running = true;
+    m_thread = std::thread(&WebSocketReactor::Run, this);
+    m_threadId = m_thread.get_id();
+}
+
+WebSocketReactor::~WebSocketReactor() {
+    if (!m_thread.joinable()) return;
+    m_running = false;
+    m_poller->Wake();
+    m_thread.join();
+    ProcessCommands(); // a Remove() that raced with shutdown is still waiting on its promise
+}
+
+void WebSocketReactor::Post(const Command& cmd) {
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        m_commands.push_back(cmd);
+    }
+    if (!OnReactorThread()) m_poller->Wake();
+}
+
+void WebSocketReactor::Add(WebSocketClient* client) {
+    Post({ CommandType::Add, client, nullptr });
+}
+
+void WebSocketReactor::Remove(WebSocketClient* client) {
+    if (!m_running) return;
+    if (OnReactorThread()) {
+        Drop(client);
+        return;
+    }
+
+    std::promise<void> done;
+    auto removed = done.get_future();
+    Post({ CommandType::Remove, client, &done });
+    removed.wait();
+}
+
+void WebSocketReactor::ScheduleWrite(WebSocketClient* client) {
+    Post({ CommandType::Write, client, nullptr });
+}
+
+void WebSocketReactor::ProcessCommands() {
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        m_processing.swap(m_commands);
+    }
+
+    for (const auto& cmd : m_processing) {
+        WebSocketClient* client = cmd.client;
+        switch (cmd.type) {
+            case CommandType::Add:
+                if (!m_poller->Add(client->m_socket, client)) {
+                    client->OnDetached();
+                    break;
+                }
+                m_clients.insert(client);
+                m_count++;
+                if (client->m_parser.Buffered() && !client->DispatchMessages()) { // arrived with the handshake
+                    Drop(client);
+                    break;
+                }
+                HandleWrite(client); // anything queued before the client was attached
+                break;
+            case CommandType::Remove:
+                Drop(client);
+                cmd.done->set_value();
+                break;
+            case CommandType::Write:
+                if (m_clients.count(client)) HandleWrite(client);
+                break;
+        }
+    }
+    m_processing.clear();
+}
+
+void WebSocketReactor::HandleWrite(WebSocketClient* client) {
+    client->m_writeScheduled = false;
+    switch (client->WritePending()) {
+        case WebSocketClient::WriteStatus::WouldBlock:
+            if (!client->m_wantWrite) {
+                m_poller->SetWriteInterest(client->m_socket, client, true);
+                client->m_wantWrite = true;
+            }
+            break;
+        case WebSocketClient::WriteStatus::Idle:
+            if (client->m_wantWrite) {
+                m_poller->SetWriteInterest(client->m_socket, client, false);
+                client->m_wantWrite = false;
+            }
+            break;
+        case WebSocketClient::WriteStatus::Failed:
+            Drop(client);
+            break;
+    }
+}
+
+void WebSocketReactor::Drop(WebSocketClient* client) {
+    if (!m_clients.erase(client)) return;
+    m_poller->Remove(client->m_socket);
+    m_count--;
+    client->OnDetached();
+}
+
+void WebSocketReactor::Run() {
+    Poller::Event events[kMaxEvents];
+    auto nextTick = std::chrono::steady_clock::now() + kTick;
+
+    while (m_running) {
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextTick - std::chrono::steady_clock::now());
+        int n = m_poller->Wait(events, kMaxEvents, (int)std::max<int64_t>(0, wait.count()));
+        ProcessCommands();
+
+        for (int i = 0; i < n; ++i) {
+            auto* client = static_cast<WebSocketClient*>(events[i].ctx);
+            if (!m_clients.count(client)) continue; // dropped earlier in this batch
+
+            if (events[i].readable || events[i].error) {
+                if (!client->OnReadable()) {
+                    Drop(client);
+                    continue;
+                }
+            }
+            if (events[i].writable) HandleWrite(client);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextTick) {
+            for (auto* client : m_clients) client->KeepaliveTick();
+            nextTick = now + kTick;
+        }
+
+        // Writes queued by callbacks and keepalive pings on this thread
+        ProcessCommands();
+    }
+
+    ProcessCommands();
+    while (!m_clients.empty()) Drop(*m_clients.begin());
+}
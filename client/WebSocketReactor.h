@@ -0,0 +1,84 @@
+#pragma once
+#include "SocketCompat.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class WebSocketClient;
+
+// Readiness backend for WebSocketReactor: epoll on Linux, WSAPoll/poll elsewhere.
+// Another mechanism (e.g. IOCP) can be plugged in by implementing this interface.
+class Poller {
+public:
+    struct Event {
+        void* ctx;
+        bool readable;
+        bool writable;
+        bool error;
+    };
+
+    virtual ~Poller() = default;
+    virtual bool Add(SOCKET s, void* ctx) = 0;                   // read interest
+    virtual bool SetWriteInterest(SOCKET s, void* ctx, bool on) = 0;
+    virtual void Remove(SOCKET s) = 0;
+    virtual int Wait(Event* out, int maxEvents, int timeoutMs) = 0;
+    virtual void Wake() = 0;                                      // any thread: interrupts Wait()
+
+    static std::unique_ptr<Poller> CreateDefault();
+};
+
+// One thread that owns many non-blocking WebSocketClient connections and dispatches
+// their reads, writes and keepalive timers. Use several reactors to spread load over
+// a few threads. Attach a client with WebSocketClient::SetReactor() before Connect().
+class WebSocketReactor {
+public:
+    explicit WebSocketReactor(std::unique_ptr<Poller> poller = Poller::CreateDefault());
+    ~WebSocketReactor();
+
+    WebSocketReactor(const WebSocketReactor&) = delete;
+    WebSocketReactor& operator=(const WebSocketReactor&) = delete;
+
+    bool Ok() const { return m_poller != nullptr; }
+    size_t ConnectionCount() const { return m_count.load(); }
+
+private:
+    friend class WebSocketClient;
+
+    // Called by WebSocketClient
+    void Add(WebSocketClient* client);
+    void Remove(WebSocketClient* client); // returns once the reactor no longer touches `client`
+    void ScheduleWrite(WebSocketClient* client);
+
+    enum class CommandType { Add, Remove, Write };
+    struct Command {
+        CommandType type;
+        WebSocketClient* client;
+        std::promise<void>* done;
+    };
+
+    void Post(const Command& cmd);
+    void Run();
+    void ProcessCommands();
+    void HandleWrite(WebSocketClient* client);
+    void Drop(WebSocketClient* client);
+    bool OnReactorThread() const { return std::this_thread::get_id() == m_threadId; }
+
+    static constexpr int kMaxEvents = 256;
+    static constexpr std::chrono::milliseconds kTick{ 250 }; // keepalive resolution
+
+    std::unique_ptr<Poller> m_poller;
+    std::thread m_thread;
+    std::thread::id m_threadId;
+    std::atomic<bool> m_running{ false };
+    std::atomic<size_t> m_count{ 0 };
+
+    std::mutex m_commandMutex;
+    std::vector<Command> m_commands;
+    std::vector<Command> m_processing;       // reactor thread only
+    std::unordered_set<WebSocketClient*> m_clients; // reactor thread only
+};
@@ -0,0 +1,125 @@
+#include "WinHttpTransport.h"
+#include "Utf8.h"
+
+#pragma comment(lib, "winhttp.lib")
+
+WinHttpTransport::WinHttpTransport(const std::wstring& host, INTERNET_PORT port, bool secure)
+    : m_secure(secure) {
+    m_session = ::WinHttpOpen(L"MatrixClient/1.0",
+                              WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                              WINHTTP_NO_PROXY_NAME,
+                              WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!m_session) return;
+
+    DWORD maxConnections = kMaxConnections;
+    ::WinHttpSetOption(m_session, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &maxConnections, sizeof(maxConnections));
+    // Counts new connections; reused ones never reach CONNECTED_TO_SERVER
+    ::WinHttpSetStatusCallback(m_session, &WinHttpTransport::OnStatus, WINHTTP_CALLBACK_FLAG_CONNECT_TO_SERVER, 0);
+
+    m_connect = ::WinHttpConnect(m_session, host.c_str(), port, 0);
+}
+
+WinHttpTransport::~WinHttpTransport() {
+    CancelAll();
+    if (m_connect) ::WinHttpCloseHandle(m_connect);
+    if (m_session) ::WinHttpCloseHandle(m_session);
+}
+
+void CALLBACK WinHttpTransport::OnStatus(HINTERNET, DWORD_PTR context, DWORD status, LPVOID, DWORD) {
+    if (status == WINHTTP_CALLBACK_STATUS_CONNECTED_TO_SERVER && context)
+        reinterpret_cast<WinHttpTransport*>(context)->m_connectionsOpened++;
+}
+
+void WinHttpTransport::SetTimeout(std::chrono::milliseconds timeout) {
+    if (!m_session) return;
+    DWORD ms = static_cast<DWORD>(timeout.count());
+    ::WinHttpSetOption(m_session, WINHTTP_OPTION_SEND_TIMEOUT, &ms, sizeof(ms));
+    ::WinHttpSetOption(m_session, WINHTTP_OPTION_RECEIVE_TIMEOUT, &ms, sizeof(ms));
+    ::WinHttpSetOption(m_session, WINHTTP_OPTION_RECEIVE_RESPONSE_TIMEOUT, &ms, sizeof(ms));
+}
+
+HttpTransportStats WinHttpTransport::GetStats() const {
+    return { m_requests.load(), m_connectionsOpened.load() };
+}
+
+void WinHttpTransport::CancelAll() {
+    // Closing a request handle from another thread is how WinHTTP aborts a synchronous call blocked
+    // on it: the call fails with ERROR_WINHTTP_OPERATION_CANCELLED. The handle is closed here, so
+    // its owner must not close it again and makes no further calls on it.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [id, request] : m_inflight) {
+        if (!request) continue;
+        ::WinHttpCloseHandle(request);
+        request = nullptr;
+    }
+}
+
+bool WinHttpTransport::Live(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_inflight.find(id);
+    return it != m_inflight.end() && it->second;
+}
+
+HttpResponse WinHttpTransport::Request(std::string_view method, std::string_view target,
+                                       std::string_view body, std::string_view bearerToken) {
+    m_requests++;
+    if (!m_connect) return {};
+
+    std::wstring wideMethod = Utf8ToWide(method);
+    std::wstring wideTarget = Utf8ToWide(target);
+    HINTERNET request = ::WinHttpOpenRequest(m_connect, wideMethod.c_str(), wideTarget.c_str(),
+                                             nullptr, WINHTTP_NO_REFERER,
+                                             WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                             m_secure ? WINHTTP_FLAG_SECURE : 0);
+    if (!request) return {};
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        id = m_nextId++;
+        m_inflight.emplace(id, request);
+    }
+
+    std::wstring headers;
+    if (!bearerToken.empty()) headers = L"Authorization: Bearer " + Utf8ToWide(bearerToken) + L"\r\n";
+    if (!body.empty()) headers += L"Content-Type: application/json\r\n";
+
+    HttpResponse response;
+    bool ok = Live(id) && ::WinHttpSendRequest(request,
+                                   headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(),
+                                   (DWORD)-1L,
+                                   body.empty() ? WINHTTP_NO_REQUEST_DATA : (LPVOID)body.data(),
+                                   (DWORD)body.size(),
+                                   (DWORD)body.size(),
+                                   reinterpret_cast<DWORD_PTR>(this))
+              && Live(id) && ::WinHttpReceiveResponse(request, nullptr);
+
+    DWORD status = 0;
+    DWORD statusSize = sizeof(status);
+    ok = ok && Live(id) && ::WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                                     WINHTTP_HEADER_NAME_BY_INDEX, &status, &statusSize,
+                                     WINHTTP_NO_HEADER_INDEX);
+
+    // The connection only goes back to WinHTTP's pool once the body has been read to the end
+    while (ok) {
+        DWORD available = 0;
+        if (!Live(id) || !::WinHttpQueryDataAvailable(request, &available)) { ok = false; break; }
+        if (available == 0) break;
+        size_t old = response.body.size();
+        response.body.resize(old + available);
+        DWORD read = 0;
+        if (!Live(id) || !::WinHttpReadData(request, response.body.data() + old, available, &read)) { ok = false; break; }
+        response.body.resize(old + read);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_inflight.find(id);
+        if (it->second) ::WinHttpCloseHandle(it->second);
+        else ok = false; // CancelAll() closed it; the body may be cut short
+        m_inflight.erase(it);
+    }
+
+    if (!ok) return {};
+    response.status = static_cast<int>(status);
+    return response;
+}
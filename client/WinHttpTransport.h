@@ -0,0 +1,47 @@
+#pragma once
+#include "HttpTransport.h"
+#include <windows.h>
+#include <winhttp.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// HttpTransport over WinHTTP. The session and the connect handle live as long as the transport,
+// so WinHTTP keeps the TCP + TLS connections underneath alive and reuses them (up to
+// kMaxConnections at once) instead of dialing and negotiating TLS for every request.
+class WinHttpTransport : public HttpTransport {
+public:
+    explicit WinHttpTransport(const std::wstring& host,
+                              INTERNET_PORT port = INTERNET_DEFAULT_HTTPS_PORT,
+                              bool secure = true);
+    ~WinHttpTransport() override;
+
+    WinHttpTransport(const WinHttpTransport&) = delete;
+    WinHttpTransport& operator=(const WinHttpTransport&) = delete;
+
+    HttpResponse Request(std::string_view method, std::string_view target,
+                         std::string_view body, std::string_view bearerToken = {}) override;
+    void CancelAll() override;
+    void SetTimeout(std::chrono::milliseconds timeout) override; // send and receive; connect keeps its default
+    HttpTransportStats GetStats() const override;
+
+private:
+    static void CALLBACK OnStatus(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD length);
+    bool Live(uint64_t id); // not cancelled since it was opened
+
+    static constexpr DWORD kMaxConnections = 4;
+
+    HINTERNET m_session = nullptr;
+    HINTERNET m_connect = nullptr;
+    bool m_secure;
+
+    std::mutex m_mutex;
+    // Open requests by a per-request ID (handle values are reused once closed). CancelAll() closes
+    // the handles and leaves null behind; the owner closes the handle only if it is still there.
+    std::unordered_map<uint64_t, HINTERNET> m_inflight;
+    uint64_t m_nextId = 0;
+
+    std::atomic<uint64_t> m_requests{ 0 };
+    std::atomic<uint64_t> m_connectionsOpened{ 0 };
+};
@@ -0,0 +1,77 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t threads, size_t maxQueue)
+    : m_threadCount(std::max<size_t>(threads, 1)), m_maxQueue(maxQueue) {
+    Start();
+}
+
+WorkerPool::~WorkerPool() {
+    Stop();
+}
+
+bool WorkerPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop || m_queue.size() >= m_maxQueue) {
+            m_stats.rejected++;
+            return false;
+        }
+        m_queue.push_back(std::move(task));
+        m_stats.submitted++;
+        m_stats.peakQueueDepth = std::max(m_stats.peakQueueDepth, m_queue.size());
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+void WorkerPool::Start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_stop) return;
+    m_stop = false;
+    for (size_t i = 0; i < m_threadCount; ++i)
+        m_threads.emplace_back(&WorkerPool::Run, this);
+}
+
+void WorkerPool::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) return;
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_threads) t.join();
+    m_threads.clear();
+}
+
+WorkerPool::Stats WorkerPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats s = m_stats;
+    s.queueDepth = m_queue.size();
+    return s;
+}
+
+void WorkerPool::Run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty()) return; // stopped and drained
+
+        auto task = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_stats.busy++;
+        lock.unlock();
+
+        bool ok = true;
+        try {
+            task();
+        } catch (...) {
+            ok = false;
+        }
+        task = nullptr; // release captures before the task counts as completed
+
+        lock.lock();
+        m_stats.busy--;
+        ok ? m_stats.completed++ : m_stats.failed++;
+    }
+}
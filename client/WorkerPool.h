@@ -0,0 +1,53 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running fire-and-forget tasks from a bounded FIFO queue. Nothing is kept
+// once a task has run (no futures to reap), so memory stays at most maxQueue tasks however long
+// the session. Tasks must not throw; an escaping exception is caught and counted as failed.
+class WorkerPool {
+public:
+    struct Stats {
+        size_t queueDepth = 0;     // waiting, not yet picked up
+        size_t peakQueueDepth = 0;
+        size_t busy = 0;           // running right now
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t rejected = 0;     // queue full or stopped
+    };
+
+    explicit WorkerPool(size_t threads = 2, size_t maxQueue = 256);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Any thread. Never blocks; false when the queue is full or the pool is stopped.
+    bool Submit(std::function<void()> task);
+
+    // Starts the threads again after Stop(); no-op while running
+    void Start();
+    // Refuses new tasks, runs everything already queued, then joins the threads
+    void Stop();
+
+    Stats GetStats() const;
+
+private:
+    void Run();
+
+    size_t m_threadCount;
+    size_t m_maxQueue;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_queue;
+    bool m_stop = true;
+    Stats m_stats;
+    std::vector<std::thread> m_threads;
+};
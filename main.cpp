@@ -33,7 +33,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
         App::SetupMatrix(matrix, chat);
         App::SetupMessageSending(sharedBuffer, matrix);
 
-        if (!App::PromptRoomChoice(matrix)) {
+        // A resumed session is back in its last room already; otherwise ask
+        if (!matrix.EnterResumedRoom() && !App::PromptRoomChoice(matrix)) {
             PostQuitMessage(1);
         }
     });
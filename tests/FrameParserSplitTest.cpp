@@ -0,0 +1,163 @@
+// WebSocketFrameParser must decode a stream the same way wherever recv() happened to cut it. One
+// encoded stream covers 2-, 4- and 10-byte headers (7-, 16- and 64-bit lengths), each masked and
+// unmasked, and fragmented messages with pings and a close interleaved between the fragments. It
+// is parsed in one piece, byte by byte, and split at random offsets, into a small ring that has to
+// wrap and grow as well as a default one, and every run must give the messages that were encoded.
+#include "WebSocketFrameParser.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+struct Decoded {
+    WsOpcode opcode;
+    std::string payload;
+
+    bool operator==(const Decoded& other) const { return opcode == other.opcode && payload == other.payload; }
+};
+
+// ----------------- Encoder -----------------
+static void AppendFrame(std::vector<uint8_t>& stream, bool fin, WsOpcode opcode, const std::string& payload,
+                        bool masked, std::mt19937& rng) {
+    stream.push_back(static_cast<uint8_t>((fin ? 0x80 : 0) | static_cast<uint8_t>(opcode)));
+    const uint8_t maskBit = masked ? 0x80 : 0;
+    const uint64_t n = payload.size();
+    if (n < 126) {
+        stream.push_back(static_cast<uint8_t>(maskBit | n));
+    } else if (n <= 0xFFFF) {
+        stream.push_back(maskBit | 126);
+        for (int shift = 8; shift >= 0; shift -= 8) stream.push_back(static_cast<uint8_t>(n >> shift));
+    } else {
+        stream.push_back(maskBit | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) stream.push_back(static_cast<uint8_t>(n >> shift));
+    }
+    uint8_t mask[4] = {};
+    if (masked) {
+        for (uint8_t& b : mask) b = static_cast<uint8_t>(rng());
+        stream.insert(stream.end(), mask, mask + 4);
+    }
+    for (size_t i = 0; i < payload.size(); ++i) stream.push_back(static_cast<uint8_t>(payload[i]) ^ mask[i & 3]);
+}
+
+static std::string Payload(size_t n, std::mt19937& rng) {
+    std::string s(n, '\0');
+    for (char& c : s) c = static_cast<char>(rng());
+    return s;
+}
+
+// Appends the frames to `stream` and the messages they decode to `expected`
+static void BuildStream(std::vector<uint8_t>& stream, std::vector<Decoded>& expected) {
+    std::mt19937 rng(7);
+    for (bool masked : { false, true }) {
+        // Single frames: 7-bit lengths (including empty), 16-bit at both ends, 64-bit
+        for (size_t n : { 0, 1, 125, 126, 300, 65535, 65536, 70000 }) {
+            std::string payload = Payload(n, rng);
+            WsOpcode opcode = n % 2 ? WsOpcode::Binary : WsOpcode::Text;
+            AppendFrame(stream, true, opcode, payload, masked, rng);
+            expected.push_back({ opcode, payload });
+        }
+
+        // A fragmented text message with a ping, a pong and a close between its fragments; the
+        // middle fragment has a 64-bit length, the last an empty payload
+        const std::string parts[4] = { Payload(10, rng), Payload(500, rng), Payload(66000, rng), {} };
+        const std::string ping = Payload(125, rng), pong = Payload(3, rng), close = "\x03\xe8" "bye";
+        AppendFrame(stream, false, WsOpcode::Text, parts[0], masked, rng);
+        AppendFrame(stream, false, WsOpcode::Continuation, parts[1], masked, rng);
+        AppendFrame(stream, true, WsOpcode::Ping, ping, masked, rng);
+        AppendFrame(stream, true, WsOpcode::Pong, pong, !masked, rng);
+        AppendFrame(stream, false, WsOpcode::Continuation, parts[2], !masked, rng);
+        AppendFrame(stream, true, WsOpcode::Close, close, masked, rng);
+        AppendFrame(stream, true, WsOpcode::Continuation, parts[3], masked, rng);
+        expected.push_back({ WsOpcode::Ping, ping });
+        expected.push_back({ WsOpcode::Pong, pong });
+        expected.push_back({ WsOpcode::Close, close });
+        expected.push_back({ WsOpcode::Text, parts[0] + parts[1] + parts[2] });
+
+        // Many short fragments, with an empty ping between each
+        std::string whole;
+        for (int i = 0; i < 20; ++i) {
+            std::string part = Payload(i * 7, rng);
+            whole += part;
+            AppendFrame(stream, i == 19, i ? WsOpcode::Continuation : WsOpcode::Binary, part, masked, rng);
+            if (i < 19) AppendFrame(stream, true, WsOpcode::Ping, {}, masked, rng);
+        }
+        for (int i = 0; i < 19; ++i) expected.push_back({ WsOpcode::Ping, {} });
+        expected.push_back({ WsOpcode::Binary, whole });
+    }
+}
+
+// ----------------- Parsing -----------------
+// Feeds `stream` in pieces of the given sizes (the rest in one piece once they run out), draining
+// every complete message after each piece. False on a parser error.
+static bool Parse(const std::vector<uint8_t>& stream, const std::vector<size_t>& pieces, size_t initialCapacity,
+                  std::vector<Decoded>& out) {
+    WebSocketFrameParser parser(initialCapacity);
+    size_t pos = 0, piece = 0;
+    while (pos < stream.size()) {
+        size_t n = piece < pieces.size() ? pieces[piece++] : stream.size() - pos;
+        n = std::min(n, stream.size() - pos);
+        while (n > 0) {
+            std::span<uint8_t> span = parser.WritableSpan();
+            size_t take = std::min(n, span.size());
+            std::copy(stream.begin() + pos, stream.begin() + pos + take, span.begin());
+            parser.Commit(take);
+            pos += take;
+            n -= take;
+        }
+        WsMessage message;
+        WebSocketFrameParser::Result r;
+        while ((r = parser.Next(message)) == WebSocketFrameParser::Result::Message)
+            out.push_back({ message.opcode, std::string(message.payload) });
+        if (r == WebSocketFrameParser::Result::Error) {
+            std::fprintf(stderr, "parser error: %s\n", parser.LastError());
+            return false;
+        }
+    }
+    return parser.Buffered() == 0;
+}
+
+static bool Check(const char* name, const std::vector<Decoded>& got, const std::vector<Decoded>& expected) {
+    if (got == expected) return true;
+    size_t i = 0;
+    while (i < got.size() && i < expected.size() && got[i] == expected[i]) ++i;
+    std::fprintf(stderr, "FAIL %s: %zu messages, %zu expected, first difference at message %zu\n", name,
+                 got.size(), expected.size(), i);
+    return false;
+}
+
+int main() {
+    std::vector<uint8_t> stream;
+    std::vector<Decoded> expected;
+    BuildStream(stream, expected);
+
+    bool ok = true;
+    for (size_t capacity : { size_t(16), size_t(4096) }) {
+        std::vector<Decoded> oneShot;
+        ok = Parse(stream, {}, capacity, oneShot) && Check("one-shot", oneShot, expected) && ok;
+
+        std::vector<Decoded> bytewise;
+        ok = Parse(stream, std::vector<size_t>(stream.size(), 1), capacity, bytewise) &&
+             Check("byte by byte", bytewise, oneShot) && ok;
+
+        // Mostly cuts within a header or a few bytes into a frame, some across whole frames
+        std::mt19937 rng(static_cast<unsigned>(capacity));
+        for (int run = 0; run < 200; ++run) {
+            std::vector<size_t> pieces;
+            for (size_t total = 0; total < stream.size();) {
+                size_t n = rng() % 4 ? 1 + rng() % 16 : 1 + rng() % 100000;
+                pieces.push_back(n);
+                total += n;
+            }
+            std::vector<Decoded> split;
+            if (!Parse(stream, pieces, capacity, split) || !Check("random split", split, oneShot)) {
+                std::fprintf(stderr, "  run %d, initial capacity %zu\n", run, capacity);
+                ok = false;
+                break;
+            }
+        }
+    }
+    std::printf("%zu-byte stream, %zu messages: %s\n", stream.size(), expected.size(), ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
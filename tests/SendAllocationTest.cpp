@@ -0,0 +1,120 @@
+// Send() must not touch the heap once the connection has warmed up: the frame goes into a pooled
+// outbound node and out with one vectored write. Global operator new is replaced to count every
+// allocation made while bursts of messages are sent to a loopback echo server and echoed back,
+// for each payload size, with the threaded client and with the reactor.
+#include "EchoServer.h"
+#include "WebSocketClient.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+
+// ----------------- Allocation counter -----------------
+static std::atomic<bool> g_counting{ false };
+static std::atomic<uint64_t> g_allocations{ 0 };
+
+static void* Allocate(size_t size) {
+    if (g_counting.load(std::memory_order_relaxed)) g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+static void* AllocateAligned(size_t size, std::align_val_t align) {
+    if (g_counting.load(std::memory_order_relaxed)) g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t a = static_cast<size_t>(align);
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return Allocate(size); }
+void* operator new[](size_t size) { return Allocate(size); }
+void* operator new(size_t size, std::align_val_t align) { return AllocateAligned(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return AllocateAligned(size, align); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// ----------------- Test -----------------
+// The outbound node pool grows to the most frames ever in flight at once, so the warm-up bursts
+// are far larger than the measured ones: every measured burst then fits in the warmed-up pool.
+static constexpr int kBurst = 64;
+static constexpr int kWarmupBurst = 16 * kBurst;
+static constexpr int kWarmupBursts = 10;
+static constexpr int kMeasuredBursts = 200;
+
+// Sends `bursts` bursts of `burst` messages, each time waiting for all of them to come back
+static bool SendBursts(WebSocketClient& client, const std::string& payload, std::atomic<uint64_t>& echoed,
+                       int burst, int bursts) {
+    for (int b = 0; b < bursts; ++b) {
+        uint64_t target = echoed.load() + burst;
+        for (int i = 0; i < burst; ++i) {
+            if (client.Send(std::string_view(payload)) != SendResult::Queued) return false;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (echoed.load() < target) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::yield();
+        }
+    }
+    return true;
+}
+
+static bool RunCase(uint16_t port, bool reactorMode, size_t size) {
+    std::unique_ptr<WebSocketReactor> reactor;
+    if (reactorMode) reactor = std::make_unique<WebSocketReactor>();
+    WebSocketClient client("127.0.0.1", port);
+    client.SetKeepalive(std::chrono::milliseconds(0));
+    if (reactor) client.SetReactor(reactor.get());
+    std::atomic<uint64_t> echoed{ 0 };
+    client.SetOnMessageView([&echoed](std::string_view) { echoed++; });
+    if (!client.Connect()) {
+        std::fprintf(stderr, "connect failed\n");
+        return false;
+    }
+
+    std::string payload(size, 'x');
+    bool ok = SendBursts(client, payload, echoed, kWarmupBurst, kWarmupBursts);
+    g_allocations = 0;
+    g_counting = true;
+    ok = ok && SendBursts(client, payload, echoed, kBurst, kMeasuredBursts);
+    g_counting = false;
+    uint64_t allocations = g_allocations.load();
+    client.Close();
+
+    const char* mode = reactorMode ? "reactor" : "threaded";
+    if (!ok) {
+        std::fprintf(stderr, "FAIL %s %zu B: echoes did not come back\n", mode, size);
+        return false;
+    }
+    std::printf("%s %6zu B: %llu allocations over %d sends\n", mode, size,
+                (unsigned long long)allocations, kBurst * kMeasuredBursts);
+    if (allocations != 0) {
+        std::fprintf(stderr, "FAIL %s %zu B: Send() allocated after warm-up\n", mode, size);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    EchoServer server;
+    if (!server.Start()) {
+        std::fprintf(stderr, "cannot start echo server\n");
+        return 1;
+    }
+
+    bool ok = true;
+    for (bool reactorMode : { false, true }) {
+        for (size_t size : { 16, 1024, 16384 }) ok = RunCase(server.Port(), reactorMode, size) && ok;
+    }
+    server.Stop();
+    return ok ? 0 : 1;
+}
@@ -5,6 +5,7 @@
 #include <utility>
 
 #define WM_MATRIX_MESSAGE (WM_APP + 100)
+#define WM_MATRIX_SEND_FAILED (WM_APP + 101)
 
 ChatWindow::ChatWindow(HINSTANCE hInstance, int width, int height, int margin, std::shared_ptr<TextBuffer> sharedBuffer)
     : m_buffer(std::move(sharedBuffer))
@@ -147,6 +148,15 @@ LRESULT ChatWindow::HandleMessage(UINT msg, WPARAM wParam, LPARAM lParam) {
             }
             return 0;
         }
+
+        case WM_MATRIX_SEND_FAILED: {
+            std::string* roomId = reinterpret_cast<std::string*>(lParam);
+            if (roomId) {
+                OnExternalMessage(L"Failed to send message to room: " + ToWString(*roomId), false);
+                delete roomId;
+            }
+            return 0;
+        }
     }
     return DefWindowProc(m_hWnd, msg, wParam, lParam);
 }